@@ -0,0 +1,64 @@
+#include "MapGenerator.h"
+
+#include <algorithm>
+#include <random>
+
+std::vector<unsigned char> GeneratePlatformerMap(const MapGenParams& params)
+{
+	int width = params.width;
+	int height = params.height;
+	std::vector<unsigned char> map(width * height, 1);
+	std::mt19937 rng(params.seed);
+
+	auto range = [&](int lo, int hi) { return lo >= hi ? lo : lo + (int)(rng() % (unsigned int)(hi - lo + 1)); };
+	auto setSolid = [&](int x, int z)
+	{
+		if (x >= 0 && x < width && z >= 0 && z < height) map[z * width + x] = 0;
+	};
+
+	// ground and side walls keep pawns on the map
+	for (int x = 0; x < width; x++)
+	{
+		setSolid(x, 0);
+	}
+	for (int z = 0; z < height; z++)
+	{
+		setSolid(0, z);
+		setSolid(width - 1, z);
+	}
+
+	// platform lengths are picked so that on average they cover platformDensity of each layer
+	float density = std::min(std::max(params.platformDensity, 0.05f), 0.95f);
+	float meanGap = 0.5f * (params.minGap + params.maxGap);
+	int meanLength = std::max(1, (int)(meanGap * density / (1.0f - density) + 0.5f));
+	int spacing = std::max(2, params.layerSpacing);
+
+	for (int layer = spacing; layer < height - 2; layer += spacing)
+	{
+		int x = 1 + range(0, params.maxGap);
+		while (x < width - 1)
+		{
+			int length = range(1, 2 * meanLength - 1);
+			int z = std::min(std::max(layer + range(-params.layerJitter, params.layerJitter), 1), height - 3);
+
+			for (int i = 0; i < length; i++)
+			{
+				setSolid(x + i, z);
+			}
+
+			// a wall at one end, so some routes have to go up and over
+			if (std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) < params.wallChance)
+			{
+				int wallX = (rng() & 1) ? x : x + length - 1;
+				for (int i = 1; i < spacing; i++)
+				{
+					setSolid(wallX, z + i);
+				}
+			}
+
+			x += length + range(params.minGap, params.maxGap);
+		}
+	}
+
+	return map;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+// Knobs for GeneratePlatformerMap. Same params and seed always give the same map.
+struct MapGenParams
+{
+	int width = 256;
+	int height = 128;
+	unsigned int seed = 1;
+	float platformDensity = 0.6f; // share of each layer covered by platforms, the rest is gaps
+	int minGap = 1; // cells between neighbouring platforms on a layer
+	int maxGap = 4;
+	int layerSpacing = 4; // rows from one layer of platforms to the next
+	int layerJitter = 1; // rows a platform can sit above or below its layer
+	float wallChance = 0.05f; // chance a platform gets a wall up to the layer above, for vertical routes
+};
+
+// Collision map in the layout BuildNavigation takes: row by row from the bottom, 1 = free, 0 = solid.
+// Solid ground and side walls, then layers of platforms with gaps between them going up the map.
+std::vector<unsigned char> GeneratePlatformerMap(const MapGenParams& params);
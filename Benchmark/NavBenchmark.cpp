@@ -0,0 +1,376 @@
+/****************************************************************************************************
+
+	Headless NavSystem benchmark. Builds generated maps from 32x32 up to 4096x1024, times every
+	stage of BuildNavigation and then FindPath over seeded sets of reachable and unreachable
+	queries, and prints the results as JSON on stdout. See README.md in this folder.
+
+ ****************************************************************************************************/
+
+#include "NavSystem.h"
+#include "MapGenerator.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+struct BenchMap
+{
+	const char* name;
+	int width;
+	int height;
+};
+
+static const BenchMap benchMaps[] =
+{
+	{ "tiny", 32, 32 },
+	{ "small", 128, 64 },
+	{ "medium", 256, 128 },
+	{ "large", 512, 256 },
+	{ "huge", 1024, 512 },
+	{ "level", 2048, 1024 },
+	{ "world", 4096, 1024 },
+};
+
+struct BenchOptions
+{
+	unsigned int seed = 1;
+	int maxWidth = 4096; // maps wider than this are skipped
+	int queries = 200; // per set
+	int repeat = 3; // builds per map, the median is reported
+	int jumpHeight = 3;
+	int pawnHeight = 1;
+	MapGenParams map;
+	NavSystem settings; // only its params are read
+	std::string heuristic = "euclidean"; // search policy, see SetPolicy
+	std::string traceFile; // NavTrace dump, needs NAV_INSTRUMENTATION
+};
+
+struct QueryStats
+{
+	int count = 0;
+	double totalMs = 0.0;
+	double meanUs = 0.0;
+	double p50Us = 0.0;
+	double p95Us = 0.0;
+	double maxUs = 0.0;
+};
+
+static double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+static QueryStats Summarize(std::vector<double> micros)
+{
+	QueryStats stats;
+	std::sort(micros.begin(), micros.end());
+	stats.count = (int)micros.size();
+	for (double us : micros)
+	{
+		stats.totalMs += us * 0.001;
+	}
+	if (stats.count > 0)
+	{
+		stats.meanUs = stats.totalMs * 1000.0 / stats.count;
+		stats.p50Us = micros[stats.count / 2];
+		stats.p95Us = micros[std::min(stats.count - 1, stats.count * 95 / 100)];
+		stats.maxUs = micros.back();
+	}
+	return stats;
+}
+
+// Friend of NavSystem, runs BuildNavigation's stages one at a time. Keep in step with BuildNavigation.
+struct NavBenchmark
+{
+	static const int numStages = 10;
+	static const char* const stageNames[numStages];
+
+	static void Build(NavSystem& nav, const BenchOptions& options, const std::vector<uint8>& map, int width, int height, double stageMs[numStages])
+	{
+		nav.mapWidth = width;
+		nav.mapHeight = height;
+		NavGraphKey key = nav.SetProfile(options.jumpHeight, options.pawnHeight, map, 0);
+
+		TSharedRef<NavGraph, ESPMode::ThreadSafe> newGraph = MakeShared<NavGraph, ESPMode::ThreadSafe>();
+		NavGraph& graph = newGraph.Get();
+		graph.key = key;
+		graph.maxDropsAfterJump = nav.maxDropsAfterJump;
+		nav.jumpStencils = JumpStencilTable(); // so stencil compiling is timed every time
+
+		int stage = 0;
+		double start = FPlatformTime::Seconds();
+		auto lap = [&]()
+		{
+			double now = FPlatformTime::Seconds();
+			stageMs[stage++] = (now - start) * 1000.0;
+			start = now;
+		};
+
+		nav.CompileJumpStencils(key.jumpHeight); lap();
+		nav.DetectPlatforms(graph, map); lap();
+		nav.CreateRunLinks(graph); lap();
+		nav.CreateFallLinks(graph); lap();
+		nav.CreateJumpLinks(graph); lap();
+		nav.FinalizeGraph(graph); lap();
+		nav.BuildHierarchy(graph); lap();
+		nav.LinkPlatforms(graph); lap();
+		nav.BuildLandmarks(graph, key.numLandmarks); lap();
+		nav.BuildComponents(graph); lap();
+
+		nav.graph = NavGraphCache::Register(key, newGraph);
+	}
+
+	static int CountEdges(const NavSystem& nav, int kind)
+	{
+		const NavGraph& graph = *nav.graph;
+		int count = 0;
+		for (int n = 0; n < graph.NumNodes(); n++)
+		{
+			if (graph.nodeCell[n] == MAX_uint32) continue;
+			for (unsigned int e = graph.edgeStart[n]; e < graph.edgeStart[n] + graph.edgeCount[n]; e++)
+			{
+				count += graph.edges[e].kind == kind;
+			}
+		}
+		return count;
+	}
+
+	static int CountNodes(const NavSystem& nav)
+	{
+		return nav.graph->NumNodes() - nav.graph->freeNodes.Num();
+	}
+
+	static int CountComponents(const NavSystem& nav)
+	{
+		return nav.graph->components.numComponents;
+	}
+
+	static void GetNavPointCells(const NavSystem& nav, std::vector<int>& cells)
+	{
+		const NavGraph& graph = *nav.graph;
+		for (int n = 0; n < graph.NumNodes(); n++)
+		{
+			if (graph.nodeCell[n] != MAX_uint32) cells.push_back(graph.nodeCell[n]);
+		}
+	}
+};
+
+const char* const NavBenchmark::stageNames[NavBenchmark::numStages] =
+{
+	"CompileJumpStencils", "DetectPlatforms", "CreateRunLinks", "CreateFallLinks", "CreateJumpLinks",
+	"FinalizeGraph", "BuildHierarchy", "LinkPlatforms", "BuildLandmarks",
+	"BuildComponents"
+};
+
+static void PrintQueryStats(const char* name, const QueryStats& stats, bool bLast)
+{
+	printf("        \"%s\": { \"count\": %d, \"total_ms\": %.3f, \"mean_us\": %.2f, \"p50_us\": %.2f, \"p95_us\": %.2f, \"max_us\": %.2f }%s\n",
+		name, stats.count, stats.totalMs, stats.meanUs, stats.p50Us, stats.p95Us, stats.maxUs, bLast ? "" : ",");
+}
+
+static bool SetPolicy(NavSystem& nav, const std::string& heuristic)
+{
+	if (heuristic == "euclidean") nav.SetSearchPolicy<NavDefaultPolicy>();
+	else if (heuristic == "manhattan") nav.SetSearchPolicy<NavManhattanPolicy>();
+	else if (heuristic == "zero") nav.SetSearchPolicy<NavDijkstraPolicy>();
+	else return false;
+	return true;
+}
+
+static void RunMap(const BenchMap& bench, const BenchOptions& options, bool bLast)
+{
+	MapGenParams params = options.map;
+	params.width = bench.width;
+	params.height = bench.height;
+	std::vector<uint8> map = GeneratePlatformerMap(params);
+
+	NavSystem nav;
+	nav.chunkSize = options.settings.chunkSize;
+	nav.numLandmarks = options.settings.numLandmarks;
+	nav.maxJumpHeight = options.settings.maxJumpHeight;
+	nav.maxPawnHeight = options.settings.maxPawnHeight;
+	nav.query = options.settings.query;
+	nav.bParallelBuild = options.settings.bParallelBuild;
+	nav.query.bUsePathCache = false; // every query has to search
+	SetPolicy(nav, options.heuristic);
+
+	// whole builds first, then stage by stage
+	std::vector<double> totals;
+	std::vector<double> stages[NavBenchmark::numStages];
+	for (int r = 0; r < options.repeat; r++)
+	{
+		NavGraphCache::Empty();
+		nav.DeleteAll();
+		double start = FPlatformTime::Seconds();
+		nav.BuildNavigation(options.jumpHeight, options.pawnHeight, bench.width, bench.height, map);
+		totals.push_back((FPlatformTime::Seconds() - start) * 1000.0);
+
+		NavGraphCache::Empty();
+		nav.DeleteAll();
+		double stageMs[NavBenchmark::numStages];
+		NavBenchmark::Build(nav, options, map, bench.width, bench.height, stageMs);
+		for (int s = 0; s < NavBenchmark::numStages; s++)
+		{
+			stages[s].push_back(stageMs[s]);
+		}
+	}
+
+	// random pairs of nav points, sorted into reachable and unreachable by an untimed first pass
+	std::vector<int> cells;
+	NavBenchmark::GetNavPointCells(nav, cells);
+	std::vector<std::pair<FVector, FVector>> sets[2];
+	std::mt19937 rng(options.seed ^ (bench.width * 7919u + bench.height));
+	int cellSize = nav.cellSize;
+
+	for (int attempt = 0; !cells.empty() && attempt < options.queries * 50; attempt++)
+	{
+		int s = cells[rng() % cells.size()];
+		int g = cells[rng() % cells.size()];
+		FVector start((s % bench.width) * cellSize + cellSize / 2, 0.0f, (s / bench.width + 1) * cellSize + 4);
+		FVector goal((g % bench.width) * cellSize + cellSize / 2, 0.0f, (g / bench.width) * cellSize + 4);
+
+		nav.FindPath(start, goal);
+		int set = nav.GetPath().Num() > 0 ? 0 : 1;
+		if ((int)sets[set].size() < options.queries)
+		{
+			sets[set].push_back(std::make_pair(start, goal));
+		}
+		if ((int)sets[0].size() == options.queries && (int)sets[1].size() == options.queries) break;
+	}
+
+	QueryStats queryStats[2];
+	for (int set = 0; set < 2; set++)
+	{
+		std::vector<double> micros;
+		for (const std::pair<FVector, FVector>& query : sets[set])
+		{
+			double start = FPlatformTime::Seconds();
+			nav.FindPath(query.first, query.second);
+			micros.push_back((FPlatformTime::Seconds() - start) * 1000000.0);
+		}
+		queryStats[set] = Summarize(micros);
+	}
+
+	printf("    {\n");
+	printf("      \"name\": \"%s\", \"width\": %d, \"height\": %d,\n", bench.name, bench.width, bench.height);
+	printf("      \"nodes\": %d, \"run_links\": %d, \"fall_links\": %d, \"jump_links\": %d,\n", NavBenchmark::CountNodes(nav),
+		NavBenchmark::CountEdges(nav, 1), NavBenchmark::CountEdges(nav, 2), NavBenchmark::CountEdges(nav, 3));
+	printf("      \"components\": %d,\n", NavBenchmark::CountComponents(nav));
+	printf("      \"build\": {\n");
+	printf("        \"total_ms\": %.3f,\n", Median(totals));
+	printf("        \"stages_ms\": {");
+	for (int s = 0; s < NavBenchmark::numStages; s++)
+	{
+		printf(" \"%s\": %.3f%s", NavBenchmark::stageNames[s], Median(stages[s]), s + 1 < NavBenchmark::numStages ? "," : " }\n");
+	}
+	printf("      },\n");
+	printf("      \"find_path\": {\n");
+	PrintQueryStats("reachable", queryStats[0], false);
+	PrintQueryStats("unreachable", queryStats[1], true);
+	printf("      }\n");
+	printf("    }%s\n", bLast ? "" : ",");
+	fflush(stdout);
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"usage: NavBenchmark [options]\n"
+		"  --seed N            map and query seed (1)\n"
+		"  --max-width N       skip maps wider than N (4096)\n"
+		"  --queries N         queries per reachable / unreachable set (200)\n"
+		"  --repeat N          builds per map, median reported (3)\n"
+		"  --jump-height N     (3)\n"
+		"  --pawn-height N     (1)\n"
+		"  --max-jump-height N multi-profile graph for jump heights up to N (0 = off)\n"
+		"  --max-pawn-height N multi-profile graph for pawn heights up to N (0 = off)\n"
+		"  --density F         platform density 0-1 (0.6)\n"
+		"  --gaps MIN MAX      gap widths between platforms (1 4)\n"
+		"  --layers N          rows between platform layers (4)\n"
+		"  --walls F           chance of a wall per platform (0.05)\n"
+		"  --chunk-size N      hierarchy chunk size, 0 = off (32)\n"
+		"  --landmarks N       ALT landmarks (0)\n"
+		"  --contract-runs     search with run shortcuts\n"
+		"  --bidirectional     search from both ends\n"
+		"  --heuristic NAME    euclidean, manhattan or zero (euclidean)\n"
+		"  --single-thread     build without ParallelFor\n"
+		"  --trace FILE        write NavTrace as Chrome trace JSON (build with -DNAV_INSTRUMENTATION=1)\n");
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool bHasValue = i + 1 < argc;
+
+		if (arg == "--seed" && bHasValue) options.seed = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--max-width" && bHasValue) options.maxWidth = atoi(argv[++i]);
+		else if (arg == "--queries" && bHasValue) options.queries = atoi(argv[++i]);
+		else if (arg == "--repeat" && bHasValue) options.repeat = std::max(1, atoi(argv[++i]));
+		else if (arg == "--jump-height" && bHasValue) options.jumpHeight = atoi(argv[++i]);
+		else if (arg == "--pawn-height" && bHasValue) options.pawnHeight = atoi(argv[++i]);
+		else if (arg == "--max-jump-height" && bHasValue) options.settings.maxJumpHeight = atoi(argv[++i]);
+		else if (arg == "--max-pawn-height" && bHasValue) options.settings.maxPawnHeight = atoi(argv[++i]);
+		else if (arg == "--density" && bHasValue) options.map.platformDensity = (float)atof(argv[++i]);
+		else if (arg == "--gaps" && i + 2 < argc) { options.map.minGap = atoi(argv[++i]); options.map.maxGap = atoi(argv[++i]); }
+		else if (arg == "--layers" && bHasValue) options.map.layerSpacing = atoi(argv[++i]);
+		else if (arg == "--walls" && bHasValue) options.map.wallChance = (float)atof(argv[++i]);
+		else if (arg == "--chunk-size" && bHasValue) options.settings.chunkSize = atoi(argv[++i]);
+		else if (arg == "--landmarks" && bHasValue) options.settings.numLandmarks = atoi(argv[++i]);
+		else if (arg == "--contract-runs") options.settings.query.bContractRuns = true;
+		else if (arg == "--bidirectional") options.settings.query.bBidirectional = true;
+		else if (arg == "--heuristic" && bHasValue && SetPolicy(options.settings, argv[i + 1])) options.heuristic = argv[++i];
+		else if (arg == "--single-thread") options.settings.bParallelBuild = false;
+		else if (arg == "--trace" && bHasValue) options.traceFile = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	options.map.seed = options.seed;
+
+	std::vector<BenchMap> maps;
+	for (const BenchMap& bench : benchMaps)
+	{
+		if (bench.width <= options.maxWidth) maps.push_back(bench);
+	}
+
+	printf("{\n");
+	printf("  \"benchmark\": \"NavSystem\",\n");
+	printf("  \"seed\": %u, \"jump_height\": %d, \"pawn_height\": %d, \"max_jump_height\": %d, \"max_pawn_height\": %d, \"chunk_size\": %d, \"landmarks\": %d,\n",
+		options.seed, options.jumpHeight, options.pawnHeight, options.settings.maxJumpHeight, options.settings.maxPawnHeight,
+		options.settings.chunkSize, options.settings.numLandmarks);
+	printf("  \"contract_runs\": %s, \"bidirectional\": %s, \"heuristic\": \"%s\", \"cores\": %d,\n", options.settings.query.bContractRuns ? "true" : "false",
+		options.settings.query.bBidirectional ? "true" : "false", options.heuristic.c_str(), FPlatformMisc::NumberOfCores());
+	printf("  \"map\": { \"density\": %.3f, \"min_gap\": %d, \"max_gap\": %d, \"layer_spacing\": %d, \"layer_jitter\": %d, \"wall_chance\": %.3f },\n",
+		options.map.platformDensity, options.map.minGap, options.map.maxGap, options.map.layerSpacing, options.map.layerJitter, options.map.wallChance);
+	printf("  \"maps\": [\n");
+	for (size_t m = 0; m < maps.size(); m++)
+	{
+		RunMap(maps[m], options, m + 1 == maps.size());
+	}
+	printf("  ]\n");
+	printf("}\n");
+
+	if (!options.traceFile.empty())
+	{
+#if NAV_INSTRUMENTATION
+		if (!NavTrace::DumpChromeTrace(options.traceFile.c_str()))
+		{
+			fprintf(stderr, "Couldn't write %s\n", options.traceFile.c_str());
+			return 1;
+		}
+#else
+		fprintf(stderr, "--trace needs a build with -DNAV_INSTRUMENTATION=1\n");
+		return 1;
+#endif
+	}
+
+	return 0;
+}
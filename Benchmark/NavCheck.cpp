@@ -0,0 +1,445 @@
+/****************************************************************************************************
+
+	Headless NavSystem checker. Runs seeded queries through every query mode (corridor, flat, run
+	shortcuts, bidirectional, landmarks, nearest goal, sliced, batched, path cache) and compares each
+	path cost with FindPath<NavDijkstraPolicy> on a fresh flat build of the same map. Then does the
+	same after a run of UpdateRegion edits, after saving and loading the edited graphs, for a
+	multi-profile graph and for a streamed window. Exits with 1 on any mismatch. See README.md.
+
+ ****************************************************************************************************/
+
+#include "NavSystem.h"
+#include "MapGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+struct CheckOptions
+{
+	unsigned int seed = 1;
+	int width = 256;
+	int height = 128;
+	int queries = 200; // per mode
+	int edits = 40; // UpdateRegion calls before the second round
+	int sliceExpansions = 64; // StepPath budget in the sliced mode
+};
+
+struct CheckQuery
+{
+	FVector start;
+	FVector goal;
+};
+
+enum class ECheckMode : uint8
+{
+	Plain,
+	ContractRuns,
+	Bidirectional,
+	NearestGoal,
+	Sliced,
+	Batch,
+	PathCache,
+	Count
+};
+
+static const char* const modeNames[(int)ECheckMode::Count] =
+{
+	"plain", "contract-runs", "bidirectional", "nearest-goal", "sliced", "batch", "path-cache"
+};
+
+static int totalMismatches = 0;
+
+static float PathCost(const NavSystem& nav)
+{
+	return nav.GetPath().Num() > 0 ? nav.GetPath()[0]->G : -1.0f;
+}
+
+// Costs are sums of the same link costs in a different order, so allow a little rounding
+static bool SameCost(float cost, float expected)
+{
+	if (cost < 0.0f || expected < 0.0f)
+	{
+		return (cost < 0.0f) == (expected < 0.0f);
+	}
+	return std::fabs(cost - expected) <= 0.001f * std::max(1.0f, expected);
+}
+
+// Random pairs of standable cells, in world units the way SnapStart and SnapGoal read them
+static std::vector<CheckQuery> MakeQueries(const std::vector<uint8>& map, int width, int height, int count, std::mt19937& rng)
+{
+	std::vector<int> cells;
+	for (int z = 1; z < height; z++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			if (map[z * width + x] != 0 && map[(z - 1) * width + x] == 0)
+			{
+				cells.push_back(z * width + x);
+			}
+		}
+	}
+
+	std::vector<CheckQuery> queries;
+	for (int q = 0; !cells.empty() && q < count; q++)
+	{
+		int s = cells[rng() % cells.size()];
+		int g = cells[rng() % cells.size()];
+		CheckQuery query;
+		query.start = FVector((s % width) * 32 + 16, 0.0f, (s / width + 1) * 32 + 4);
+		query.goal = FVector((g % width) * 32 + 16, 0.0f, (g / width) * 32 + 4);
+		queries.push_back(query);
+	}
+	return queries;
+}
+
+static std::vector<CheckQuery> OffsetQueries(const std::vector<CheckQuery>& queries, float dx)
+{
+	std::vector<CheckQuery> out = queries;
+	for (CheckQuery& query : out)
+	{
+		query.start.X += dx;
+		query.goal.X += dx;
+	}
+	return out;
+}
+
+// The reference: a fresh flat build, no landmarks, no cache, searched with a zero heuristic
+static std::vector<float> ReferenceCosts(const std::vector<uint8>& map, int width, int height, int jumpHeight, int pawnHeight, const std::vector<CheckQuery>& queries)
+{
+	NavGraphCache::Empty();
+	NavSystem nav;
+	nav.chunkSize = 0;
+	nav.numLandmarks = 0;
+	nav.query.bUsePathCache = false;
+	nav.BuildNavigation(jumpHeight, pawnHeight, width, height, map);
+
+	std::vector<float> costs;
+	for (const CheckQuery& query : queries)
+	{
+		nav.FindPath<NavDijkstraPolicy>(query.start, query.goal);
+		costs.push_back(PathCost(nav));
+	}
+	return costs;
+}
+
+static std::vector<float> RunQueries(NavSystem& nav, ECheckMode mode, const std::vector<CheckQuery>& queries, int jumpHeight, int pawnHeight, const CheckOptions& options)
+{
+	nav.query = NavQuerySettings();
+	nav.query.bUsePathCache = mode == ECheckMode::PathCache;
+	nav.query.bContractRuns = mode == ECheckMode::ContractRuns;
+	nav.query.bBidirectional = mode == ECheckMode::Bidirectional;
+	nav.query.bNearestReachableGoal = mode == ECheckMode::NearestGoal;
+
+	std::vector<float> costs;
+	if (mode == ECheckMode::Batch)
+	{
+		TArray<NavPathRequest> requests;
+		for (const CheckQuery& query : queries)
+		{
+			requests.Add({ query.start, query.goal, jumpHeight, pawnHeight });
+		}
+		NavPathBatch batch;
+		nav.FindPaths(requests, batch);
+		for (int i = 0; i < batch.results.Num(); i++)
+		{
+			costs.push_back(batch.results[i].cost);
+		}
+		return costs;
+	}
+
+	if (mode == ECheckMode::PathCache)
+	{
+		for (const CheckQuery& query : queries) // fill the cache, the second pass below is what's checked
+		{
+			nav.FindPath(query.start, query.goal);
+		}
+	}
+
+	for (const CheckQuery& query : queries)
+	{
+		if (mode == ECheckMode::Sliced)
+		{
+			nav.BeginPath(query.start, query.goal);
+			while (nav.StepPath(options.sliceExpansions) == ENavPathStatus::InProgress)
+			{
+			}
+		}
+		else
+		{
+			nav.FindPath(query.start, query.goal);
+		}
+		costs.push_back(PathCost(nav));
+	}
+	return costs;
+}
+
+static void Compare(const std::string& label, const std::vector<float>& costs, const std::vector<float>& expected, bool bReachableOnly)
+{
+	int checked = 0;
+	int reachable = 0;
+	int mismatches = 0;
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		float cost = i < costs.size() ? costs[i] : -2.0f;
+		if (bReachableOnly && expected[i] < 0.0f) continue; // nearest-goal paths somewhere else on purpose
+
+		checked++;
+		reachable += expected[i] >= 0.0f;
+		if (!SameCost(cost, expected[i]))
+		{
+			if (mismatches < 3)
+			{
+				printf("  %s: query %d costs %.3f, Dijkstra %.3f\n", label.c_str(), (int)i, cost, expected[i]);
+			}
+			mismatches++;
+		}
+	}
+	printf("%-40s %4d queries, %4d reachable, %d mismatches\n", label.c_str(), checked, reachable, mismatches);
+	totalMismatches += mismatches;
+}
+
+static void CheckModes(const std::string& label, NavSystem& nav, const std::vector<CheckQuery>& queries, const std::vector<float>& expected, int jumpHeight, int pawnHeight, const CheckOptions& options)
+{
+	for (int m = 0; m < (int)ECheckMode::Count; m++)
+	{
+		ECheckMode mode = (ECheckMode)m;
+		std::vector<float> costs = RunQueries(nav, mode, queries, jumpHeight, pawnHeight, options);
+		Compare(label + " " + modeNames[m], costs, expected, mode == ECheckMode::NearestGoal);
+	}
+}
+
+// Hierarchy and landmark settings the query modes are run under
+struct CheckGraph
+{
+	const char* name;
+	int chunkSize;
+	int numLandmarks;
+};
+
+static const CheckGraph checkGraphs[] =
+{
+	{ "flat", 0, 0 },
+	{ "chunked", 32, 0 },
+	{ "landmarks", 32, 4 },
+};
+
+static const int numCheckGraphs = sizeof(checkGraphs) / sizeof(checkGraphs[0]);
+
+static void ConfigureSystem(NavSystem& nav, const CheckGraph& check)
+{
+	nav.chunkSize = check.chunkSize;
+	nav.numLandmarks = check.numLandmarks;
+}
+
+// Every graph kind before and after edits, then saved and loaded with and without validation
+static void CheckEdits(std::vector<uint8> map, const CheckOptions& options, std::mt19937& rng)
+{
+	const int width = options.width;
+	const int height = options.height;
+	std::vector<CheckQuery> queries = MakeQueries(map, width, height, options.queries, rng);
+	std::vector<float> expected = ReferenceCosts(map, width, height, 3, 1, queries);
+
+	NavSystem systems[numCheckGraphs];
+	for (int i = 0; i < numCheckGraphs; i++)
+	{
+		ConfigureSystem(systems[i], checkGraphs[i]);
+		systems[i].BuildNavigation(3, 1, width, height, map);
+		CheckModes(checkGraphs[i].name, systems[i], queries, expected, 3, 1, options);
+	}
+
+	// small edits away from the border walls, the same ones on every system and on the map. Versioned, so
+	// LoadNavigation can be told which version of the map the saved graphs are for.
+	uint32 mapVersion = 0;
+	for (int e = 0; e < options.edits; e++)
+	{
+		int editWidth = 1 + rng() % 4;
+		int editHeight = 1 + rng() % 2;
+		int x0 = 1 + rng() % (width - editWidth - 1);
+		int z0 = 1 + rng() % (height - editHeight - 1);
+		std::vector<uint8> cells(editWidth * editHeight);
+		for (int j = 0; j < editHeight; j++)
+		{
+			for (int i = 0; i < editWidth; i++)
+			{
+				cells[j * editWidth + i] = (rng() % 3) != 0;
+				map[(z0 + j) * width + x0 + i] = cells[j * editWidth + i];
+			}
+		}
+		mapVersion = 1000 + e;
+		for (NavSystem& nav : systems)
+		{
+			nav.UpdateRegion(x0, z0, x0 + editWidth - 1, z0 + editHeight - 1, cells, mapVersion);
+		}
+	}
+
+	queries = MakeQueries(map, width, height, options.queries, rng);
+	expected = ReferenceCosts(map, width, height, 3, 1, queries);
+	for (int i = 0; i < numCheckGraphs; i++)
+	{
+		CheckModes(std::string(checkGraphs[i].name) + " edited", systems[i], queries, expected, 3, 1, options);
+	}
+	systems[numCheckGraphs - 1].UpdateLandmarks();
+	CheckModes(std::string(checkGraphs[numCheckGraphs - 1].name) + " edited+updated", systems[numCheckGraphs - 1], queries, expected, 3, 1, options);
+
+	const FString filename = TEXT("NavCheck.nav");
+	for (int i = 0; i < numCheckGraphs; i++)
+	{
+		if (!systems[i].SaveNavigation(filename))
+		{
+			printf("%s: SaveNavigation failed\n", checkGraphs[i].name);
+			totalMismatches++;
+			continue;
+		}
+		for (int validate = 0; validate < 2; validate++)
+		{
+			NavGraphCache::Empty(); // or the load finds the graph still cached
+			NavSystem loaded;
+			ConfigureSystem(loaded, checkGraphs[i]);
+			loaded.bValidateNavFiles = validate != 0;
+			std::string label = std::string(checkGraphs[i].name) + (validate ? " loaded" : " loaded-trusted");
+			if (!loaded.LoadNavigation(filename, 3, 1, width, height, map, mapVersion))
+			{
+				printf("%s: LoadNavigation rejected the file\n", label.c_str());
+				totalMismatches++;
+			}
+			Compare(label + " " + modeNames[(int)ECheckMode::Plain], RunQueries(loaded, ECheckMode::Plain, queries, 3, 1, options), expected, false);
+		}
+	}
+	remove(*filename);
+}
+
+// One multi-profile graph against a dedicated build per pawn profile
+static void CheckProfiles(const std::vector<uint8>& map, const CheckOptions& options, std::mt19937& rng)
+{
+	static const int profiles[][2] = { { 2, 1 }, { 3, 1 }, { 4, 2 } };
+
+	NavGraphCache::Empty();
+	NavSystem nav;
+	nav.maxJumpHeight = 4;
+	nav.maxPawnHeight = 2;
+	nav.BuildNavigation(3, 1, options.width, options.height, map);
+
+	std::vector<CheckQuery> queries = MakeQueries(map, options.width, options.height, options.queries, rng);
+	for (const int* profile : profiles)
+	{
+		std::vector<float> expected = ReferenceCosts(map, options.width, options.height, profile[0], profile[1], queries);
+		std::vector<float> costs = RunQueries(nav, ECheckMode::Batch, queries, profile[0], profile[1], options);
+		Compare("multi-profile jump " + std::to_string(profile[0]) + " pawn " + std::to_string(profile[1]), costs, expected, false);
+	}
+}
+
+// Strips attached forwards past the window and back again, each window against a fresh build of what's attached
+static void CheckStreaming(const CheckOptions& options, std::mt19937& rng)
+{
+	const int stripWidth = 32;
+	const int height = 64;
+	const int maxStrips = 4;
+	const int numStrips = 12;
+
+	MapGenParams params;
+	params.width = stripWidth * numStrips;
+	params.height = height;
+	params.seed = options.seed;
+	std::vector<uint8> world = GeneratePlatformerMap(params);
+
+	NavSystem nav;
+	nav.chunkSize = 16;
+	nav.BeginStreaming(3, 1, stripWidth, height, maxStrips);
+
+	std::vector<int> order;
+	for (int s = 0; s < numStrips; s++) order.push_back(s);
+	for (int s = numStrips - 2; s >= 0; s--) order.push_back(s);
+
+	std::vector<float> costs;
+	std::vector<float> expected;
+	for (int strip : order)
+	{
+		std::vector<uint8> cells(stripWidth * height);
+		for (int z = 0; z < height; z++)
+		{
+			for (int x = 0; x < stripWidth; x++)
+			{
+				cells[z * stripWidth + x] = world[z * params.width + strip * stripWidth + x];
+			}
+		}
+		nav.AttachStrip(strip, cells);
+
+		// the window as a map, solid where nothing is attached
+		int firstStrip = nav.GetStreamOrigin() / stripWidth;
+		int windowWidth = maxStrips * 2 * stripWidth;
+		std::vector<uint8> window(windowWidth * height, 0);
+		for (int slot = 0; slot < maxStrips * 2; slot++)
+		{
+			if (!nav.IsStripAttached(firstStrip + slot)) continue;
+			for (int z = 0; z < height; z++)
+			{
+				for (int x = 0; x < stripWidth; x++)
+				{
+					window[z * windowWidth + slot * stripWidth + x] = world[z * params.width + (firstStrip + slot) * stripWidth + x];
+				}
+			}
+		}
+
+		std::vector<CheckQuery> queries = MakeQueries(window, windowWidth, height, 10, rng);
+		std::vector<float> stripExpected = ReferenceCosts(window, windowWidth, height, 3, 1, queries);
+		std::vector<float> stripCosts = RunQueries(nav, ECheckMode::Plain, OffsetQueries(queries, nav.GetStreamOrigin() * 32.0f), 3, 1, options);
+		expected.insert(expected.end(), stripExpected.begin(), stripExpected.end());
+		costs.insert(costs.end(), stripCosts.begin(), stripCosts.end());
+	}
+	Compare("streamed", costs, expected, false);
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"usage: NavCheck [options]\n"
+		"  --seed N            map and query seed (1)\n"
+		"  --size W H          map size in cells (256 128)\n"
+		"  --queries N         queries per mode (200)\n"
+		"  --edits N           UpdateRegion calls before the second round (40)\n"
+		"  --slice N           StepPath expansions per call in the sliced mode (64)\n");
+}
+
+int main(int argc, char** argv)
+{
+	CheckOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool bHasValue = i + 1 < argc;
+		if (arg == "--seed" && bHasValue) options.seed = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--size" && i + 2 < argc) { options.width = atoi(argv[++i]); options.height = atoi(argv[++i]); }
+		else if (arg == "--queries" && bHasValue) options.queries = atoi(argv[++i]);
+		else if (arg == "--edits" && bHasValue) options.edits = atoi(argv[++i]);
+		else if (arg == "--slice" && bHasValue) options.sliceExpansions = atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return arg == "--help" ? 0 : 2;
+		}
+	}
+	if (options.width < 8 || options.height < 8 || options.queries < 1 || options.sliceExpansions < 1)
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	MapGenParams params;
+	params.width = options.width;
+	params.height = options.height;
+	params.seed = options.seed;
+	std::vector<uint8> map = GeneratePlatformerMap(params);
+	std::mt19937 rng(options.seed);
+	NavPathCache::SetCapacity(options.queries); // so the path-cache mode's second pass hits
+
+	CheckEdits(map, options, rng);
+	CheckProfiles(map, options, rng);
+	CheckStreaming(options, rng);
+
+	printf("%s: %d mismatches\n", totalMismatches == 0 ? "passed" : "FAILED", totalMismatches);
+	return totalMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,482 @@
+#pragma once
+
+/****************************************************************************************************
+
+	Stand-ins for the handful of engine types NavSystem uses, so it can be built and benchmarked
+	without Unreal. Force-included ahead of NavSystem.cpp, see README.md in this folder.
+
+	Only what NavSystem calls is here, with the same names and semantics as the engine versions
+	(TArray is a std::vector, TMap an unordered_map, and so on). Timings are meant to compare
+	revisions of NavSystem against each other, not to predict in-engine numbers exactly.
+
+ ****************************************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+typedef uint8_t uint8;
+typedef int8_t int8;
+typedef uint16_t uint16;
+typedef int16_t int16;
+typedef uint32_t uint32;
+typedef int32_t int32;
+typedef uint64_t uint64;
+typedef int64_t int64;
+typedef char TCHAR;
+
+#define TEXT(x) x
+#define MAX_flt 3.402823466e+38F
+#define MAX_int32 2147483647
+#define MAX_uint8 0xff
+#define MAX_uint32 0xffffffffu
+#define MAX_int64 INT64_MAX
+#define INDEX_NONE -1
+
+#define check(expr) do { if (!(expr)) { fprintf(stderr, "Check failed: %s (%s:%d)\n", #expr, __FILE__, __LINE__); abort(); } } while (0)
+
+// NavSystem logs every failed query, which would drown the benchmark output, so logging is opt in
+#ifdef NAVBENCH_LOG
+#define UE_LOG(Category, Verbosity, Format, ...) fprintf(stderr, "[" #Verbosity "] " Format "\n", ##__VA_ARGS__)
+#else
+#define UE_LOG(Category, Verbosity, Format, ...) do { } while (0)
+#endif
+
+class UWorld;
+
+template <typename T>
+typename std::remove_reference<T>::type&& MoveTemp(T&& value)
+{
+	return std::move(value);
+}
+
+// Containers
+
+template <typename T>
+class TArray
+{
+public:
+	TArray() {}
+	TArray(std::initializer_list<T> list) : data(list) {}
+
+	int32 Num() const { return (int32)data.size(); }
+	int32 Max() const { return (int32)data.capacity(); }
+	T* GetData() { return data.data(); }
+	const T* GetData() const { return data.data(); }
+
+	T& operator[](int32 i) { checkIndex(i); return data[i]; }
+	const T& operator[](int32 i) const { checkIndex(i); return data[i]; }
+	T& Last() { return data.back(); }
+	const T& Last() const { return data.back(); }
+
+	int32 Add(const T& item) { data.push_back(item); return Num() - 1; }
+	int32 Add(T&& item) { data.push_back(std::move(item)); return Num() - 1; }
+	int32 AddDefaulted(int32 count = 1) { int32 first = Num(); data.resize(first + count); return first; }
+	int32 AddZeroed(int32 count = 1) { int32 first = Num(); data.resize(first + count); zero(first, count); return first; }
+	void Append(const TArray& other) { data.insert(data.end(), other.data.begin(), other.data.end()); }
+	void Append(const T* items, int32 count) { data.insert(data.end(), items, items + count); }
+	T Pop(bool /*bAllowShrinking*/ = true) { check(Num() > 0); T item = std::move(data.back()); data.pop_back(); return item; }
+
+	void Init(const T& value, int32 count) { data.assign(count, value); }
+	void SetNum(int32 count, bool /*bAllowShrinking*/ = true) { data.resize(count); }
+	void SetNumUninitialized(int32 count, bool /*bAllowShrinking*/ = true) { data.resize(count); }
+	void SetNumZeroed(int32 count, bool /*bAllowShrinking*/ = true) { int32 first = Num(); data.resize(count); if (count > first) zero(first, count - first); }
+	void Reserve(int32 count) { data.reserve(count); }
+	void Reset(int32 slack = 0) { data.clear(); data.reserve(slack); }
+	void Empty(int32 slack = 0) { std::vector<T>().swap(data); data.reserve(slack); }
+
+	bool Contains(const T& item) const { return std::find(data.begin(), data.end(), item) != data.end(); }
+	int32 Find(const T& item) const { auto it = std::find(data.begin(), data.end(), item); return it == data.end() ? INDEX_NONE : (int32)(it - data.begin()); }
+	void Swap(int32 a, int32 b) { std::swap(data[a], data[b]); }
+	void Sort() { std::sort(data.begin(), data.end()); }
+	template <typename Predicate> void Sort(Predicate predicate) { std::sort(data.begin(), data.end(), predicate); }
+
+	// min-heap on operator<, as the engine's default heap predicate gives
+	void HeapPush(const T& item) { data.push_back(item); std::push_heap(data.begin(), data.end(), greater); }
+	void HeapPop(T& item, bool /*bAllowShrinking*/ = true) { std::pop_heap(data.begin(), data.end(), greater); item = std::move(data.back()); data.pop_back(); }
+	const T& HeapTop() const { return data.front(); }
+
+	bool operator==(const TArray& other) const { return data == other.data; }
+	bool operator!=(const TArray& other) const { return data != other.data; }
+
+	typename std::vector<T>::iterator begin() { return data.begin(); }
+	typename std::vector<T>::iterator end() { return data.end(); }
+	typename std::vector<T>::const_iterator begin() const { return data.begin(); }
+	typename std::vector<T>::const_iterator end() const { return data.end(); }
+
+private:
+	static bool greater(const T& a, const T& b) { return b < a; }
+	void checkIndex(int32 i) const { check(i >= 0 && i < Num()); }
+	void zero(int32 first, int32 count) { if (count > 0) memset((void*)&data[first], 0, sizeof(T) * count); }
+
+	std::vector<T> data;
+};
+
+inline uint32 GetTypeHash(int32 value) { return (uint32)value; }
+inline uint32 GetTypeHash(uint32 value) { return value; }
+
+// Bob Jenkins' mix, as in the engine
+inline uint32 HashCombine(uint32 a, uint32 c)
+{
+	uint32 b = 0x9e3779b9;
+	a += b;
+	a -= b; a -= c; a ^= (c >> 13);
+	b -= c; b -= a; b ^= (a << 8);
+	c -= a; c -= b; c ^= (b >> 13);
+	a -= b; a -= c; a ^= (c >> 12);
+	b -= c; b -= a; b ^= (a << 16);
+	c -= a; c -= b; c ^= (b >> 5);
+	a -= b; a -= c; a ^= (c >> 3);
+	b -= c; b -= a; b ^= (a << 10);
+	c -= a; c -= b; c ^= (b >> 15);
+	return c;
+}
+
+template <typename KeyType>
+struct TShimKeyHash
+{
+	size_t operator()(const KeyType& key) const { return GetTypeHash(key); }
+};
+
+template <typename KeyType, typename ValueType>
+class TMap
+{
+	typedef std::unordered_map<KeyType, ValueType, TShimKeyHash<KeyType>> MapType;
+
+public:
+	class TIterator
+	{
+	public:
+		TIterator(MapType& map) : map(map), it(map.begin()) {}
+		explicit operator bool() const { return it != map.end(); }
+		TIterator& operator++() { if (!bRemoved) ++it; bRemoved = false; return *this; }
+		const KeyType& Key() const { return it->first; }
+		ValueType& Value() const { return it->second; }
+		void RemoveCurrent() { it = map.erase(it); bRemoved = true; }
+
+	private:
+		MapType& map;
+		typename MapType::iterator it;
+		bool bRemoved = false;
+	};
+
+	ValueType* Find(const KeyType& key) { auto it = pairs.find(key); return it == pairs.end() ? nullptr : &it->second; }
+	const ValueType* Find(const KeyType& key) const { auto it = pairs.find(key); return it == pairs.end() ? nullptr : &it->second; }
+	ValueType& Add(const KeyType& key, const ValueType& value) { return pairs[key] = value; }
+	bool Contains(const KeyType& key) const { return pairs.count(key) != 0; }
+	int32 Remove(const KeyType& key) { return (int32)pairs.erase(key); }
+	int32 Num() const { return (int32)pairs.size(); }
+	void Empty() { pairs.clear(); }
+	TIterator CreateIterator() { return TIterator(pairs); }
+
+private:
+	MapType pairs;
+};
+
+// Smart pointers
+
+enum class ESPMode { NotThreadSafe, ThreadSafe };
+
+template <typename T, ESPMode Mode = ESPMode::NotThreadSafe> class TSharedRef;
+
+template <typename T, ESPMode Mode = ESPMode::NotThreadSafe>
+class TSharedPtr
+{
+public:
+	TSharedPtr() {}
+	TSharedPtr(std::nullptr_t) {}
+	TSharedPtr(std::shared_ptr<T> pointer) : pointer(std::move(pointer)) {}
+	template <typename Other> TSharedPtr(const TSharedPtr<Other, Mode>& other) : pointer(other.pointer) {}
+	template <typename Other> TSharedPtr(const TSharedRef<Other, Mode>& other) : pointer(other.pointer) {}
+
+	T* operator->() const { check(pointer); return pointer.get(); }
+	T& operator*() const { return *pointer; }
+	T* Get() const { return pointer.get(); }
+	bool IsValid() const { return (bool)pointer; }
+	bool IsUnique() const { return pointer.use_count() == 1; }
+	void Reset() { pointer.reset(); }
+	bool operator==(const TSharedPtr& other) const { return pointer == other.pointer; }
+	bool operator!=(const TSharedPtr& other) const { return pointer != other.pointer; }
+
+	std::shared_ptr<T> pointer;
+};
+
+template <typename T, ESPMode Mode>
+class TSharedRef
+{
+public:
+	explicit TSharedRef(T* object) : pointer(object) {}
+	TSharedRef(std::shared_ptr<T> pointer) : pointer(std::move(pointer)) {}
+
+	T* operator->() const { return pointer.get(); }
+	T& operator*() const { return *pointer; }
+	T& Get() const { return *pointer; }
+
+	std::shared_ptr<T> pointer;
+};
+
+template <typename T, ESPMode Mode = ESPMode::NotThreadSafe>
+class TWeakPtr
+{
+public:
+	TWeakPtr() {}
+	template <typename Other> TWeakPtr(const TSharedPtr<Other, Mode>& other) : pointer(other.pointer) {}
+	template <typename Other> TWeakPtr(const TSharedRef<Other, Mode>& other) : pointer(other.pointer) {}
+
+	TSharedPtr<T, Mode> Pin() const { return TSharedPtr<T, Mode>(pointer.lock()); }
+	bool IsValid() const { return !pointer.expired(); }
+
+	std::weak_ptr<T> pointer;
+};
+
+template <typename T, ESPMode Mode = ESPMode::NotThreadSafe, typename... ArgTypes>
+TSharedRef<T, Mode> MakeShared(ArgTypes&&... args)
+{
+	return TSharedRef<T, Mode>(std::make_shared<T>(std::forward<ArgTypes>(args)...));
+}
+
+template <typename T, ESPMode Mode>
+TSharedPtr<T, Mode> ConstCastSharedPtr(const TSharedPtr<const T, Mode>& pointer)
+{
+	return TSharedPtr<T, Mode>(std::const_pointer_cast<T>(pointer.pointer));
+}
+
+template <typename T> using TUniquePtr = std::unique_ptr<T>;
+
+// Platform
+
+struct FPlatformMath
+{
+	template <typename T> static T Abs(T value) { return value < 0 ? -value : value; }
+	template <typename T> static T Min(T a, T b) { return a < b ? a : b; }
+	template <typename T> static T Max(T a, T b) { return a > b ? a : b; }
+	static float Pow(float a, float b) { return powf(a, b); }
+	static float Sqrt(float value) { return sqrtf(value); }
+	static int32 FloorToInt(float value) { return (int32)floorf(value); }
+
+	static uint64 CountTrailingZeros64(uint64 value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanForward64(&index, value) ? index : 64;
+#else
+		return value ? __builtin_ctzll(value) : 64;
+#endif
+	}
+};
+
+struct FMath : FPlatformMath
+{
+};
+
+struct FMemory
+{
+	static void* Memcpy(void* dest, const void* src, size_t count) { return memcpy(dest, src, count); }
+	static void* Memzero(void* dest, size_t count) { return memset(dest, 0, count); }
+};
+
+struct FPlatformTime
+{
+	static double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+};
+
+struct FPlatformMisc
+{
+	static int32 NumberOfCores() { return FPlatformMath::Max(1, (int32)std::thread::hardware_concurrency()); }
+};
+
+// The engine's versions are intrinsics on a plain int64, here the same memory is used as a std::atomic
+struct FPlatformAtomics
+{
+	static int64 InterlockedIncrement(volatile int64* value) { return ++*(std::atomic<int64>*)value; }
+	static int64 InterlockedExchange(volatile int64* value, int64 exchange) { return ((std::atomic<int64>*)value)->exchange(exchange); }
+	static int64 AtomicRead(volatile const int64* value) { return ((const std::atomic<int64>*)value)->load(); }
+};
+
+struct FPlatformTLS
+{
+	static uint32 GetCurrentThreadId() { return (uint32)std::hash<std::thread::id>()(std::this_thread::get_id()); }
+};
+
+struct FCrc
+{
+	static uint32 MemCrc32(const void* data, int32 length, uint32 crc = 0)
+	{
+		const uint8* bytes = (const uint8*)data;
+		crc = ~crc;
+		for (int32 i = 0; i < length; i++)
+		{
+			crc ^= bytes[i];
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+			}
+		}
+		return ~crc;
+	}
+};
+
+class FCriticalSection
+{
+public:
+	void Lock() { mutex.lock(); }
+	void Unlock() { mutex.unlock(); }
+
+private:
+	std::mutex mutex;
+};
+
+class FScopeLock
+{
+public:
+	FScopeLock(FCriticalSection* section) : section(section) { section->Lock(); }
+	~FScopeLock() { section->Unlock(); }
+
+private:
+	FCriticalSection* section;
+};
+
+// Runs the body on one thread per core, handing out indices as they finish, like the task graph would
+inline void ParallelFor(int32 num, std::function<void(int32)> body, bool bForceSingleThread = false)
+{
+	int32 threadCount = FPlatformMath::Min(num, FPlatformMisc::NumberOfCores());
+	if (bForceSingleThread || threadCount <= 1)
+	{
+		for (int32 i = 0; i < num; i++)
+		{
+			body(i);
+		}
+		return;
+	}
+
+	std::atomic<int32> next(0);
+	std::vector<std::thread> threads;
+	for (int32 t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([&]()
+		{
+			for (int32 i = next++; i < num; i = next++)
+			{
+				body(i);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+// Core types
+
+struct FVector
+{
+	float X, Y, Z;
+
+	FVector() {}
+	FVector(float x, float y, float z) : X(x), Y(y), Z(z) {}
+
+	static const FVector ZeroVector;
+};
+
+inline const FVector FVector::ZeroVector(0.0f, 0.0f, 0.0f);
+
+class FString
+{
+public:
+	FString() {}
+	FString(const char* text) : text(text) {}
+
+	template <typename... Types>
+	static FString Printf(const TCHAR* format, Types... args)
+	{
+		int length = snprintf(nullptr, 0, format, args...);
+		std::string result(length > 0 ? length : 0, '\0');
+		snprintf(&result[0], result.size() + 1, format, args...);
+		return FString(result.c_str());
+	}
+
+	FString& operator+=(const FString& other) { text += other.text; return *this; }
+	FString& operator+=(const TCHAR* other) { text += other; return *this; }
+	const TCHAR* operator*() const { return text.c_str(); }
+	int32 Len() const { return (int32)text.size(); }
+
+private:
+	std::string text;
+};
+
+// Files
+
+struct FFileHelper
+{
+	static bool SaveArrayToFile(const TArray<uint8>& bytes, const TCHAR* filename)
+	{
+		FILE* file = fopen(filename, "wb");
+		if (!file) return false;
+		bool bWritten = fwrite(bytes.GetData(), 1, bytes.Num(), file) == (size_t)bytes.Num();
+		return fclose(file) == 0 && bWritten;
+	}
+
+	static bool SaveStringToFile(const FString& text, const TCHAR* filename)
+	{
+		FILE* file = fopen(filename, "wb");
+		if (!file) return false;
+		bool bWritten = fwrite(*text, 1, text.Len(), file) == (size_t)text.Len();
+		return fclose(file) == 0 && bWritten;
+	}
+};
+
+class IFileHandle
+{
+public:
+	IFileHandle(FILE* file) : file(file) {}
+	~IFileHandle() { fclose(file); }
+
+	int64 Size()
+	{
+		fseek(file, 0, SEEK_END);
+		return (int64)ftell(file);
+	}
+
+	bool Seek(int64 position) { return fseek(file, (long)position, SEEK_SET) == 0; }
+	bool Read(uint8* destination, int64 bytesToRead) { return fread(destination, 1, (size_t)bytesToRead, file) == (size_t)bytesToRead; }
+
+private:
+	FILE* file;
+};
+
+class IPlatformFile
+{
+public:
+	IFileHandle* OpenRead(const TCHAR* filename)
+	{
+		FILE* file = fopen(filename, "rb");
+		return file ? new IFileHandle(file) : nullptr;
+	}
+};
+
+class FPlatformFileManager
+{
+public:
+	static FPlatformFileManager& Get() { static FPlatformFileManager manager; return manager; }
+	IPlatformFile& GetPlatformFile() { return platformFile; }
+
+private:
+	IPlatformFile platformFile;
+};
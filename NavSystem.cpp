@@ -6,683 +6,3823 @@
 	
 	An instance is created within the pawn each time it needs to calculate a new path if the terrain 
 	has changed since the last path calculation, or the jump height of the pawn changes. Each pawn 
-	needs its own instance, as they have different jump heights etc.
+	needs its own instance for its search state, but the built graph only depends on the terrain and 
+	the jump profile, so pawns that match share one read-only graph through NavGraphCache. With
+	maxJumpHeight / maxPawnHeight set, every pawn shares one graph built for the largest profile, and
+	each link notes which jump heights and pawn heights can take it.
+
+	On large maps the graph also carries a chunk hierarchy. Queries between chunks that aren't
+	neighbours search it first and then run the regular A* only inside the chunks it picked.
+
+	Scrolling worlds can be streamed instead of built whole (BeginStreaming). The graph is then a
+	fixed window of strip slots that strips are attached to and evicted from as the camera moves.
 
  ****************************************************************************************************/
 
+FCriticalSection NavGraphCache::lock;
+TMap<NavGraphKey, TWeakPtr<const NavGraph, ESPMode::ThreadSafe>> NavGraphCache::graphs;
+
+NavGraphPtr NavGraphCache::Find(const NavGraphKey& key)
+{
+	FScopeLock scopeLock(&lock);
+
+	const TWeakPtr<const NavGraph, ESPMode::ThreadSafe>* entry = graphs.Find(key);
+	return entry ? entry->Pin() : NavGraphPtr();
+}
+
+NavGraphPtr NavGraphCache::Register(const NavGraphKey& key, NavGraphPtr graph)
+{
+	FScopeLock scopeLock(&lock);
+
+	// another pawn may have finished building the same graph while we were busy
+	TWeakPtr<const NavGraph, ESPMode::ThreadSafe>* entry = graphs.Find(key);
+	if (entry)
+	{
+		NavGraphPtr existing = entry->Pin();
+		if (existing.IsValid())
+		{
+			return existing;
+		}
+	}
+
+	// drop entries whose graphs have already been freed
+	for (auto it = graphs.CreateIterator(); it; ++it)
+	{
+		if (!it.Value().IsValid())
+		{
+			it.RemoveCurrent();
+		}
+	}
+
+	graphs.Add(key, graph);
+	return graph;
+}
+
+void NavGraphCache::Remove(const NavGraphKey& key)
+{
+	FScopeLock scopeLock(&lock);
+	graphs.Remove(key);
+}
+
+// The check and the removal happen under the lock, so no other thread can pin the graph from the cache in between.
+// A graph someone else also holds stays registered.
+bool NavGraphCache::TakeIfUnique(const NavGraphPtr& graph)
+{
+	FScopeLock scopeLock(&lock);
+
+	if (!graph.IsUnique())
+	{
+		return false;
+	}
+
+	// only drop the entry if it's this graph, not another one built for the same key
+	const TWeakPtr<const NavGraph, ESPMode::ThreadSafe>* entry = graphs.Find(graph->key);
+	if (entry && entry->Pin() == graph)
+	{
+		graphs.Remove(graph->key);
+	}
+	return true;
+}
+
+void NavGraphCache::Empty()
+{
+	FScopeLock scopeLock(&lock);
+	graphs.Empty();
+}
+
+FCriticalSection NavPathCache::lock;
+TMap<NavPathKey, int> NavPathCache::slots;
+TArray<NavPathCache::Entry> NavPathCache::entries;
+int NavPathCache::head = -1;
+int NavPathCache::tail = -1;
+int NavPathCache::capacity = 256;
+uint64 NavPathCache::hits = 0;
+uint64 NavPathCache::misses = 0;
+uint32 NavPathCache::nextPolicyId = 0;
+
+bool NavPathCache::Find(const NavPathKey& key, NavPathBatch& path)
+{
+	FScopeLock scopeLock(&lock);
+
+	const int* slot = slots.Find(key);
+	if (!slot)
+	{
+		misses++;
+		return false;
+	}
+
+	hits++;
+	Unlink(*slot);
+	LinkAtHead(*slot);
+	path = entries[*slot].path;
+	return true;
+}
+
+void NavPathCache::Add(const NavPathKey& key, const NavPathBatch& path)
+{
+	FScopeLock scopeLock(&lock);
+
+	if (capacity <= 0 || slots.Contains(key))
+	{
+		return;
+	}
+
+	// take a new slot until full, then reuse the least recently used one
+	int slot;
+	if (entries.Num() < capacity)
+	{
+		slot = entries.AddDefaulted();
+	}
+	else
+	{
+		slot = tail;
+		Unlink(slot);
+		slots.Remove(entries[slot].key);
+	}
+
+	entries[slot].key = key;
+	entries[slot].path = path;
+	LinkAtHead(slot);
+	slots.Add(key, slot);
+}
+
+void NavPathCache::SetCapacity(int maxPaths)
+{
+	FScopeLock scopeLock(&lock);
+
+	capacity = maxPaths;
+	while (entries.Num() > FPlatformMath::Max(capacity, 0)) // drop from the cold end and pack the survivors down
+	{
+		int slot = tail;
+		Unlink(slot);
+		slots.Remove(entries[slot].key);
+
+		int last = entries.Num() - 1;
+		if (slot != last)
+		{
+			entries[slot] = MoveTemp(entries[last]);
+			slots.Add(entries[slot].key, slot);
+			if (entries[slot].prev >= 0) entries[entries[slot].prev].next = slot; else head = slot;
+			if (entries[slot].next >= 0) entries[entries[slot].next].prev = slot; else tail = slot;
+		}
+		entries.Pop(false);
+	}
+}
+
+void NavPathCache::GetStats(uint64& outHits, uint64& outMisses)
+{
+	FScopeLock scopeLock(&lock);
+	outHits = hits;
+	outMisses = misses;
+}
+
+void NavPathCache::ResetStats()
+{
+	FScopeLock scopeLock(&lock);
+	hits = 0;
+	misses = 0;
+}
+
+void NavPathCache::Empty()
+{
+	FScopeLock scopeLock(&lock);
+	slots.Empty();
+	entries.Empty();
+	head = -1;
+	tail = -1;
+}
+
+uint32 NavPathCache::NewPolicyId()
+{
+	FScopeLock scopeLock(&lock);
+	return nextPolicyId++;
+}
+
+void NavPathCache::Unlink(int slot)
+{
+	Entry& entry = entries[slot];
+	if (entry.prev >= 0) entries[entry.prev].next = entry.next; else head = entry.next;
+	if (entry.next >= 0) entries[entry.next].prev = entry.prev; else tail = entry.prev;
+	entry.prev = -1;
+	entry.next = -1;
+}
+
+void NavPathCache::LinkAtHead(int slot)
+{
+	Entry& entry = entries[slot];
+	entry.prev = -1;
+	entry.next = head;
+	if (head >= 0) entries[head].prev = slot;
+	head = slot;
+	if (tail < 0) tail = slot;
+}
+
+#if NAV_INSTRUMENTATION
+
+NavTraceEvent NavTrace::events[NAVTRACE_CAPACITY];
+volatile int64 NavTrace::sequences[NAVTRACE_CAPACITY];
+volatile int64 NavTrace::head = 0;
+
+// Writers never wait on each other or on a dump. Each slot is stamped -1 while it's written and with the
+// event's index once it's done, so a dump can tell a finished event from one that's half overwritten.
+void NavTrace::Record(const NavTraceEvent& event)
+{
+	int64 index = FPlatformAtomics::InterlockedIncrement(&head) - 1;
+	int slot = (int)(index & (NAVTRACE_CAPACITY - 1));
+
+	FPlatformAtomics::InterlockedExchange(&sequences[slot], -1);
+	events[slot] = event;
+	events[slot].threadId = FPlatformTLS::GetCurrentThreadId();
+	FPlatformAtomics::InterlockedExchange(&sequences[slot], index);
+}
+
+// Every slot back to -1 first, or a slot still holding index i from before would pass for the new event i
+void NavTrace::Reset()
+{
+	for (int slot = 0; slot < NAVTRACE_CAPACITY; slot++)
+	{
+		FPlatformAtomics::InterlockedExchange(&sequences[slot], -1);
+	}
+	FPlatformAtomics::InterlockedExchange(&head, 0);
+}
+
+// Complete ("X") events with times in microseconds. Events being written during the dump are left out.
+bool NavTrace::DumpChromeTrace(const FString& filename)
+{
+	int64 end = FPlatformAtomics::AtomicRead(&head);
+	int64 first = FPlatformMath::Max(end - NAVTRACE_CAPACITY, (int64)0);
+
+	FString json = TEXT("{\"traceEvents\":[\n");
+	bool bFirst = true;
+
+	for (int64 index = first; index < end; index++)
+	{
+		int slot = (int)(index & (NAVTRACE_CAPACITY - 1));
+		if (FPlatformAtomics::AtomicRead(&sequences[slot]) != index) continue;
+
+		NavTraceEvent event = events[slot];
+		if (FPlatformAtomics::AtomicRead(&sequences[slot]) != index) continue; // overwritten while we copied it
+
+		json += FString::Printf(TEXT("%s{\"name\":\"%s\",\"cat\":\"nav\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{"),
+			bFirst ? TEXT("") : TEXT(",\n"), event.name, event.start * 1000000.0, event.duration * 1000000.0, event.threadId);
+		for (int a = 0; a < event.numArgs; a++)
+		{
+			json += FString::Printf(TEXT("%s\"%s\":%.9g"), a > 0 ? TEXT(",") : TEXT(""), event.argNames[a], event.argValues[a]);
+		}
+		json += TEXT("}}");
+		bFirst = false;
+	}
+
+	json += TEXT("\n]}\n");
+	return FFileHelper::SaveStringToFile(json, *filename);
+}
+
+#endif
+
+// Recompute the head clearance bits for a range of rows. A cell is clear if it and the verticalSize
+// cells above it are free, rows above the top of the map count as open sky.
+void NavGraph::UpdateClearance(int firstRow, int lastRow)
+{
+	firstRow = FPlatformMath::Max(firstRow, 0);
+	lastRow = FPlatformMath::Min(lastRow, (int)key.mapHeight - 1);
+	clearBits.SetNumZeroed(freeBits.Num());
+
+	for (int z = firstRow; z <= lastRow; z++)
+	{
+		int top = FPlatformMath::Min(z + key.pawnHeight, (int)key.mapHeight - 1);
+
+		for (int w = 0; w < rowWords; w++)
+		{
+			uint64 bits = freeBits[z * rowWords + w];
+			for (int i = z + 1; i <= top; i++)
+			{
+				bits &= freeBits[i * rowWords + w];
+			}
+			clearBits[z * rowWords + w] = bits;
+		}
+	}
+}
+
 NavSystem::NavSystem(void)
 {
 	navMap.Empty();
+	SetSearchPolicy<NavDefaultPolicy>();
 }
 
 NavSystem::~NavSystem(void)
 {
 }
 
-TArray<TSharedPtr<PathNode>> NavSystem::GetPath()
+const TArray<const PathNode*>& NavSystem::GetPath() const
 {
 	return pathNodesToGoal;
 }
 
-// Initialize properties and populate node graph
-void NavSystem::BuildNavigation(int jump_height, int pawn_height, int world_width, int world_height, std::vector<uint8> collision_map)
+// Initialize properties and populate node graph, or pick up an identical one another pawn already built
+void NavSystem::BuildNavigation(int jump_height, int pawn_height, int world_width, int world_height, const std::vector<uint8>& collision_map, uint32 map_version)
 {
+	NAV_TRACE_SCOPE("BuildNavigation");
+
+	if (pathStatus == ENavPathStatus::InProgress) // a time sliced search can't carry on over a different graph
+	{
+		CancelPath();
+	}
+
 	mapWidth = world_width;
 	mapHeight = world_height;
+	NavGraphKey key = SetProfile(jump_height, pawn_height, collision_map, map_version);
+
+	NavGraphPtr cached = NavGraphCache::Find(key);
+	if (cached.IsValid())
+	{
+		graph = cached;
+		NAV_STAT(navTraceScope.event.AddArg(TEXT("cached"), 1.0));
+		return;
+	}
+
+	TSharedRef<NavGraph, ESPMode::ThreadSafe> newGraph = MakeShared<NavGraph, ESPMode::ThreadSafe>();
+	newGraph->key = key;
+	newGraph->maxDropsAfterJump = maxDropsAfterJump;
+
+	CompileJumpStencils(key.jumpHeight);
+	DetectPlatforms(newGraph.Get(), collision_map);
+	CreateRunLinks(newGraph.Get());
+	CreateFallLinks(newGraph.Get());
+	CreateJumpLinks(newGraph.Get());
+	FinalizeGraph(newGraph.Get());
+	BuildHierarchy(newGraph.Get());
+	LinkPlatforms(newGraph.Get());
+	BuildLandmarks(newGraph.Get(), key.numLandmarks);
+	BuildComponents(newGraph.Get());
+
+	graph = NavGraphCache::Register(key, newGraph);
+	NAV_STAT(AddGraphArgs(navTraceScope.event, *graph));
+}
+
+// Take on a pawn's jump profile, and work out the key of the graph that serves it: its own,
+// or the multi-profile one everybody shares if maxJumpHeight or maxPawnHeight are set
+NavGraphKey NavSystem::SetProfile(int jump_height, int pawn_height, const std::vector<uint8>& collision_map, uint32 map_version)
+{
+	jumpHeight = jump_height;
 	verticalSize = pawn_height;
-	DetectPlatforms(collision_map);
-	CreateRunLinks();
-	CreateFallLinks();
-	CreateJumpLinks(jump_height);
+
+	NavGraphKey key;
+	key.mapVersion = map_version != 0 ? map_version : FCrc::MemCrc32(collision_map.data(), collision_map.size());
+	key.mapWidth = mapWidth;
+	key.mapHeight = mapHeight;
+	key.bMultiProfile = maxJumpHeight > 0 || maxPawnHeight > 0;
+	key.jumpHeight = key.bMultiProfile ? FPlatformMath::Max(maxJumpHeight, jump_height) : jump_height;
+	key.pawnHeight = key.bMultiProfile ? FPlatformMath::Max(maxPawnHeight, pawn_height) : pawn_height;
+	key.numLandmarks = FPlatformMath::Max(numLandmarks, 0);
+	key.chunkSize = key.bMultiProfile ? 0 : FPlatformMath::Max(chunkSize, 0); // multi-profile graphs never get one
+	key.maxReachComponents = FPlatformMath::Max(maxReachComponents, 0);
+	return key;
 }
 
-// Create a node graph describing each possible location the pawn could stand,
-// and determine whether it's at the edge or in the middle
-void NavSystem::DetectPlatforms(std::vector<uint8>& MapIn)
+#if NAV_INSTRUMENTATION
+// Node count and links by kind, for the BuildNavigation event
+void NavSystem::AddGraphArgs(NavTraceEvent& event, const NavGraph& nav)
 {
-	// 0 = no nav point
-	// 1 = platform left edge
-	// 2 = platform middle
-	// 3 = platform right edge
-	// 4 = lone platform
+	int links[4] = { 0, 0, 0, 0 };
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		if (nav.nodeCell[n] == MAX_uint32) continue; // removed by UpdateRegion
 
-	navMap.Empty();
-	navMap.AddZeroed(mapWidth * mapHeight);
+		unsigned int edgeEnd = nav.edgeStart[n] + nav.edgeCount[n];
+		for (unsigned int e = nav.edgeStart[n]; e < edgeEnd; e++)
+		{
+			links[nav.edges[e].kind & 3]++;
+		}
+	}
+
+	event.AddArg(TEXT("nodes"), nav.NumNodes() - nav.freeNodes.Num());
+	event.AddArg(TEXT("run_links"), links[1]);
+	event.AddArg(TEXT("fall_links"), links[2]);
+	event.AddArg(TEXT("jump_links"), links[3]);
+}
+#endif
+
+// Append an array to a graph file being written and point its section entry at it
+template <typename T>
+static void WriteNavSection(TArray<uint8>& file, NavFileHeader& header, int section, const T* data, int count)
+{
+	int offset = (file.Num() + 7) & ~7;
+	file.SetNumZeroed(offset + count * sizeof(T));
+	if (count > 0)
+	{
+		FMemory::Memcpy(file.GetData() + offset, data, count * sizeof(T));
+	}
 
-	int platformIndex = 0;
-	bool bPlatformStarted = false;
+	header.sections[section].offset = offset;
+	header.sections[section].count = count;
+	header.sections[section].elementSize = sizeof(T);
+}
 
-	for (size_t z = 0; z < mapHeight; z++)
+// Read elements [first, first + count) of one section of a graph file straight into an array,
+// false if the section doesn't fit the file or the type, or the range doesn't fit the section
+template <typename T>
+static bool ReadNavSection(IFileHandle& file, int64 fileSize, const NavFileHeader& header, int section, TArray<T>& out, uint32 first, uint32 count)
+{
+	const NavFileSection& entry = header.sections[section];
+	if (entry.elementSize != sizeof(T) || entry.offset > (uint64)fileSize || (uint64)entry.count * sizeof(T) > (uint64)fileSize - entry.offset
+		|| first > entry.count || count > entry.count - first)
 	{
-		bPlatformStarted = false; // reset when starting new row
+		return false;
+	}
 
-		for (size_t x = 0; x < mapWidth; x++)
-		{
-			int index = z * mapWidth + x;
-			if (index >= navMap.Num()) { return; } // out of bounds check
-			
-			navMap[index].x_coord = x;
-			navMap[index].z_coord = z;
-			navMap[index].collision = MapIn[index];
+	out.SetNumUninitialized(count);
+	return count == 0 || (file.Seek(entry.offset + (uint64)first * sizeof(T)) && file.Read((uint8*)out.GetData(), (int64)count * sizeof(T)));
+}
+
+// The whole section
+template <typename T>
+static bool ReadNavSection(IFileHandle& file, int64 fileSize, const NavFileHeader& header, int section, TArray<T>& out)
+{
+	return ReadNavSection(file, fileSize, header, section, out, 0, header.sections[section].count);
+}
+
+// Every node id and array offset a loaded graph holds has to land inside the array it indexes, and the
+// searches also take a few things on trust that a damaged file could break: live links lead to live nodes,
+// cells and nodes point at each other, and links that leave a chunk run between entrances. The section
+// sizes have to be checked first. Costs are checked too, a negative or NaN one can keep a search going forever.
+static bool CheckNavIndices(const NavGraph& nav)
+{
+	const NavHierarchy& hier = nav.hierarchy;
+	int numNodes = nav.NumNodes();
+	auto IsLive = [&nav, numNodes](int node) { return node >= 0 && node < numNodes && nav.nodeCell[node] != MAX_uint32; };
+	auto IsCost = [](float cost) { return cost >= 0.0f && cost < MAX_flt; }; // false for NaN as well
+
+	for (int cell = 0; cell < nav.NumCells(); cell++)
+	{
+		int node = nav.cellToNode[cell];
+		if (node != -1 && (!IsLive(node) || nav.nodeCell[node] != (unsigned int)cell)) return false;
+	}
+
+	for (int n = 0; n < numNodes; n++)
+	{
+		unsigned int cell = nav.nodeCell[n];
+		bool bLive = cell != MAX_uint32;
+		if (bLive && (cell >= (unsigned int)nav.NumCells() || nav.cellToNode[cell] != n)) return false;
+
+		// a live node needs a component once they're built, MightReach looks its reach bits up
+		int component = nav.components.nodeComponent[n];
+		int numComponents = nav.components.numComponents;
+		if (component >= numComponents || component < (bLive && numComponents > 0 ? 0 : -1)) return false;
+
+		// the ranges of freed ids aren't followed, and their links can lead to ids that were freed too
+		if (!bLive) continue;
 
-			if (!bPlatformStarted)
+		if (nav.runSkip[n * 2] != -1 && !IsLive(nav.runSkip[n * 2])) return false;
+		if (nav.runSkip[n * 2 + 1] != -1 && !IsLive(nav.runSkip[n * 2 + 1])) return false;
+
+		if (hier.IsBuilt())
+		{
+			int slot = hier.entranceSlot[n];
+			if (slot != -1)
 			{
-				if (MapIn[index] == 1 && MapIn[index - mapWidth] == 0) // if target tile is free and one below has collision, can stand there
-				{
-					navMap[index].nav_type = 1; // the platform hadn't started yet, so it must be a left edge (or lone platform)
-					bPlatformStarted = true;
-					platformIndex++;
-				}
+				const NavChunk& chunk = hier.chunks[nav.GetChunk(n)];
+				if (slot < 0 || slot >= chunk.entrances.Num() || chunk.entrances[slot] != n) return false;
 			}
+		}
 
-			if (bPlatformStarted)
+		if ((uint64)nav.edgeStart[n] + nav.edgeCount[n] > (uint64)nav.edges.Num()) return false;
+		for (unsigned int e = nav.edgeStart[n]; e < nav.edgeStart[n] + nav.edgeCount[n]; e++)
+		{
+			const NavEdge& edge = nav.edges[e];
+			if (!IsLive(edge.target) || !IsCost(edge.cost) || (uint64)edge.pathStart + edge.pathLength > (uint64)nav.jumpPathPool.Num()) return false;
+			if (hier.IsBuilt() && nav.GetChunk(edge.target) != nav.GetChunk(n)
+				&& (hier.entranceSlot[n] < 0 || hier.entranceSlot[edge.target] < 0))
 			{
-				if (MapIn[index - mapHeight + 1] == 0	// if lower right tile collides 
-					&& MapIn[index + 1] == 1			// and right tile doesn't
-					&& navMap[index].nav_type != 1)		// and it's not a left edge
-				{
-					navMap[index].nav_type = 2;			// then it's a middle navpoint
-				}
+				return false;
+			}
+		}
 
-				if (MapIn[index - mapHeight + 1] == 1	// if lower right tile is free 
-					|| MapIn[index + 1] == 0)			// or right tile collides
-				{
-					if (navMap[index].nav_type == 1)	// and navpoint is a left edge
-					{
-						navMap[index].nav_type = 4;		// it's a lone platform
-					}
-					else
-					{
-						navMap[index].nav_type = 3;		// otherwise it's a right edge
-					}
+		if ((uint64)nav.reverseStart[n] + nav.reverseCount[n] > (uint64)nav.reverseLinks.Num()) return false;
+		for (unsigned int r = nav.reverseStart[n]; r < nav.reverseStart[n] + nav.reverseCount[n]; r++)
+		{
+			const NavReverseLink& link = nav.reverseLinks[r];
+			if (!IsLive(link.source) || link.edge >= (unsigned int)nav.edges.Num() || (int)nav.edges[link.edge].target != n) return false;
+		}
+	}
 
-					bPlatformStarted = false;
-				}
-			}
+	for (int node : nav.freeNodes)
+	{
+		if (node < 0 || node >= numNodes || IsLive(node)) return false;
+	}
+
+	for (int node : nav.landmarks.nodes)
+	{
+		if (!IsLive(node)) return false;
+	}
+
+	for (int i = 0; i < nav.landmarks.from.Num(); i++)
+	{
+		// MAX_flt where a landmark can't get there or back
+		if (!(nav.landmarks.from[i] >= 0.0f && nav.landmarks.to[i] >= 0.0f)) return false;
+	}
+
+	for (int c = 0; c < hier.chunks.Num(); c++)
+	{
+		const NavChunk& chunk = hier.chunks[c];
+		if (chunk.linkStart[0] != 0 || chunk.linkStart[chunk.entrances.Num()] != (unsigned int)chunk.links.Num()) return false;
+		for (int i = 0; i < chunk.entrances.Num(); i++)
+		{
+			int node = chunk.entrances[i];
+			if (!IsLive(node) || hier.entranceSlot[node] != i || nav.GetChunk(node) != c || chunk.linkStart[i] > chunk.linkStart[i + 1]) return false;
+		}
+		for (const NavChunkLink& link : chunk.links)
+		{
+			if (!IsLive(link.target) || !IsCost(link.cost) || hier.entranceSlot[link.target] < 0 || nav.GetChunk(link.target) != c) return false;
 		}
 	}
-}
+	return true;
+}
+
+// Write the graph out in the NAVFILE_ layout. Meant for cooking, the file only loads back on builds with the same struct layouts.
+bool NavSystem::SaveNavigation(const FString& filename) const
+{
+	NAV_TRACE_SCOPE("SaveNavigation");
+
+	if (!graph.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("No nav graph to save."));
+		return false;
+	}
+
+	UpdateComponents(); // the file holds them as they are
+	UpdateLandmarks();
+	const NavGraph& nav = *graph;
+	const NavHierarchy& hier = nav.hierarchy;
+
+	NavFileHeader header;
+	FMemory::Memzero(&header, sizeof(header));
+	header.magic = NAVFILE_MAGIC;
+	header.version = NAVFILE_VERSION;
+	header.key = nav.key;
+	header.collisionCrc = FCrc::MemCrc32(nav.freeBits.GetData(), nav.freeBits.Num() * sizeof(uint64));
+	header.maxDropsAfterJump = nav.maxDropsAfterJump;
+	header.rowWords = nav.rowWords;
+	header.deadEdges = nav.deadEdges;
+	header.deadReverseLinks = nav.deadReverseLinks;
+	header.chunkSize = hier.chunkSize;
+	header.chunksX = hier.chunksX;
+	header.chunksZ = hier.chunksZ;
+	header.numLandmarks = nav.landmarks.count;
+	header.numComponents = nav.components.numComponents;
+	header.reachWords = nav.components.reachWords;
+
+	// chunks hold their own arrays, so lay them end to end
+	TArray<unsigned int> entranceStart, linkStarts, linkOffset;
+	TArray<int> entrances;
+	TArray<NavChunkLink> links;
+	entranceStart.Add(0);
+	linkOffset.Add(0);
+	for (int c = 0; c < hier.chunks.Num(); c++)
+	{
+		entrances.Append(hier.chunks[c].entrances);
+		linkStarts.Append(hier.chunks[c].linkStart);
+		links.Append(hier.chunks[c].links);
+		entranceStart.Add(entrances.Num());
+		linkOffset.Add(links.Num());
+	}
+
+	TArray<uint8> file;
+	file.SetNumZeroed(sizeof(NavFileHeader));
+	WriteNavSection(file, header, NAVSECTION_FREEBITS, nav.freeBits.GetData(), nav.freeBits.Num());
+	WriteNavSection(file, header, NAVSECTION_CLEARBITS, nav.clearBits.GetData(), nav.clearBits.Num());
+	WriteNavSection(file, header, NAVSECTION_CELLTONODE, nav.cellToNode.GetData(), nav.cellToNode.Num());
+	WriteNavSection(file, header, NAVSECTION_NODECELL, nav.nodeCell.GetData(), nav.nodeCell.Num());
+	WriteNavSection(file, header, NAVSECTION_NODETYPE, nav.nodeType.GetData(), nav.nodeType.Num());
+	WriteNavSection(file, header, NAVSECTION_EDGESTART, nav.edgeStart.GetData(), nav.edgeStart.Num());
+	WriteNavSection(file, header, NAVSECTION_EDGECOUNT, nav.edgeCount.GetData(), nav.edgeCount.Num());
+	WriteNavSection(file, header, NAVSECTION_EDGES, nav.edges.GetData(), nav.edges.Num());
+	WriteNavSection(file, header, NAVSECTION_JUMPPATHPOOL, nav.jumpPathPool.GetData(), nav.jumpPathPool.Num());
+	WriteNavSection(file, header, NAVSECTION_FREENODES, nav.freeNodes.GetData(), nav.freeNodes.Num());
+	WriteNavSection(file, header, NAVSECTION_REVERSESTART, nav.reverseStart.GetData(), nav.reverseStart.Num());
+	WriteNavSection(file, header, NAVSECTION_REVERSECOUNT, nav.reverseCount.GetData(), nav.reverseCount.Num());
+	WriteNavSection(file, header, NAVSECTION_REVERSELINKS, nav.reverseLinks.GetData(), nav.reverseLinks.Num());
+	WriteNavSection(file, header, NAVSECTION_RUNSKIP, nav.runSkip.GetData(), nav.runSkip.Num());
+	WriteNavSection(file, header, NAVSECTION_ENTRANCESLOT, hier.entranceSlot.GetData(), hier.entranceSlot.Num());
+	WriteNavSection(file, header, NAVSECTION_CROSSIN, hier.crossIn.GetData(), hier.crossIn.Num());
+	WriteNavSection(file, header, NAVSECTION_CHUNKENTRANCESTART, entranceStart.GetData(), entranceStart.Num());
+	WriteNavSection(file, header, NAVSECTION_CHUNKENTRANCES, entrances.GetData(), entrances.Num());
+	WriteNavSection(file, header, NAVSECTION_CHUNKLINKSTART, linkStarts.GetData(), linkStarts.Num());
+	WriteNavSection(file, header, NAVSECTION_CHUNKLINKOFFSET, linkOffset.GetData(), linkOffset.Num());
+	WriteNavSection(file, header, NAVSECTION_CHUNKLINKS, links.GetData(), links.Num());
+	WriteNavSection(file, header, NAVSECTION_LANDMARKS, nav.landmarks.nodes.GetData(), nav.landmarks.nodes.Num());
+	WriteNavSection(file, header, NAVSECTION_LANDMARKFROM, nav.landmarks.from.GetData(), nav.landmarks.from.Num());
+	WriteNavSection(file, header, NAVSECTION_LANDMARKTO, nav.landmarks.to.GetData(), nav.landmarks.to.Num());
+	WriteNavSection(file, header, NAVSECTION_NODECOMPONENT, nav.components.nodeComponent.GetData(), nav.components.nodeComponent.Num());
+	WriteNavSection(file, header, NAVSECTION_REACHBITS, nav.components.reachBits.GetData(), nav.components.reachBits.Num());
+	FMemory::Memcpy(file.GetData(), &header, sizeof(header));
+
+	if (!FFileHelper::SaveArrayToFile(file, *filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't write nav file %s."), *filename);
+		return false;
+	}
+	return true;
+}
+
+// Pick up a graph SaveNavigation wrote instead of building one. Every section is read straight into the
+// array it fills, nothing gets parsed. Takes the same arguments as BuildNavigation so it can check the file
+// was built for this map and jump profile, and checks every index in it unless bValidateNavFiles is off.
+bool NavSystem::LoadNavigation(const FString& filename, int jump_height, int pawn_height, int world_width, int world_height, const std::vector<uint8>& collision_map, uint32 map_version)
+{
+	NAV_TRACE_SCOPE("LoadNavigation");
+
+	if (pathStatus == ENavPathStatus::InProgress) // a time sliced search can't carry on over a different graph
+	{
+		CancelPath();
+	}
+
+	mapWidth = world_width;
+	mapHeight = world_height;
+	NavGraphKey key = SetProfile(jump_height, pawn_height, collision_map, map_version);
+
+	NavGraphPtr cached = NavGraphCache::Find(key);
+	if (cached.IsValid())
+	{
+		graph = cached;
+		return true;
+	}
+
+	TUniquePtr<IFileHandle> handle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*filename));
+	int64 fileSize = handle ? handle->Size() : 0;
+	NavFileHeader header;
+	if (fileSize < (int64)sizeof(NavFileHeader) || !handle->Seek(0) || !handle->Read((uint8*)&header, sizeof(header)))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't read nav file %s."), *filename);
+		return false;
+	}
+
+	IFileHandle& file = *handle;
+	if (header.magic != NAVFILE_MAGIC || header.version != NAVFILE_VERSION || !(header.key == key))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Nav file %s is out of date or for another map."), *filename);
+		return false;
+	}
+
+	TSharedRef<NavGraph, ESPMode::ThreadSafe> newGraph = MakeShared<NavGraph, ESPMode::ThreadSafe>();
+	NavGraph& nav = newGraph.Get();
+	NavHierarchy& hier = nav.hierarchy;
+	nav.key = key;
+	nav.maxDropsAfterJump = header.maxDropsAfterJump;
+	nav.rowWords = header.rowWords;
+	nav.deadEdges = header.deadEdges;
+	nav.deadReverseLinks = header.deadReverseLinks;
+	hier.chunkSize = header.chunkSize;
+	hier.chunksX = header.chunksX;
+	hier.chunksZ = header.chunksZ;
+	nav.landmarks.count = header.numLandmarks;
+	nav.components.numComponents = header.numComponents;
+	nav.components.reachWords = header.reachWords;
+
+	TArray<unsigned int> entranceStart, linkOffset;
+
+	bool bRead = ReadNavSection(file, fileSize, header, NAVSECTION_FREEBITS, nav.freeBits)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_CLEARBITS, nav.clearBits)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_CELLTONODE, nav.cellToNode)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_NODECELL, nav.nodeCell)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_NODETYPE, nav.nodeType)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_EDGESTART, nav.edgeStart)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_EDGECOUNT, nav.edgeCount)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_EDGES, nav.edges)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_JUMPPATHPOOL, nav.jumpPathPool)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_FREENODES, nav.freeNodes)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_REVERSESTART, nav.reverseStart)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_REVERSECOUNT, nav.reverseCount)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_REVERSELINKS, nav.reverseLinks)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_RUNSKIP, nav.runSkip)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_ENTRANCESLOT, hier.entranceSlot)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_CROSSIN, hier.crossIn)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_CHUNKENTRANCESTART, entranceStart)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_CHUNKLINKOFFSET, linkOffset)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_LANDMARKS, nav.landmarks.nodes)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_LANDMARKFROM, nav.landmarks.from)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_LANDMARKTO, nav.landmarks.to)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_NODECOMPONENT, nav.components.nodeComponent)
+		&& ReadNavSection(file, fileSize, header, NAVSECTION_REACHBITS, nav.components.reachBits);
+
+	// sizes that have to agree before anything indexes with them
+	const NavComponents& components = nav.components;
+	int numNodes = nav.NumNodes();
+	bool bHierarchy = hier.chunkSize > 0;
+	int chunksX = bHierarchy ? (int)((mapWidth + (int64)hier.chunkSize - 1) / hier.chunkSize) : 0;
+	int chunksZ = bHierarchy ? (int)((mapHeight + (int64)hier.chunkSize - 1) / hier.chunkSize) : 0;
+	int numChunks = chunksX * chunksZ;
+	bRead = bRead && nav.NumCells() == (int)(mapWidth * mapHeight) && nav.rowWords == (int)(mapWidth + 63) / 64
+		&& nav.freeBits.Num() == nav.rowWords * (int)mapHeight && nav.clearBits.Num() == nav.freeBits.Num()
+		&& nav.nodeType.Num() == numNodes && nav.edgeStart.Num() == numNodes && nav.edgeCount.Num() == numNodes
+		&& nav.reverseStart.Num() == numNodes && nav.reverseCount.Num() == numNodes && nav.runSkip.Num() == numNodes * 2
+		&& nav.deadEdges >= 0 && nav.deadEdges <= nav.edges.Num() && nav.deadReverseLinks >= 0 && nav.deadReverseLinks <= nav.reverseLinks.Num()
+		&& (hier.chunkSize == 0 || hier.chunkSize == key.chunkSize) && hier.chunksX == chunksX && hier.chunksZ == chunksZ
+		&& hier.entranceSlot.Num() == (bHierarchy ? numNodes : 0) && hier.crossIn.Num() == hier.entranceSlot.Num()
+		&& entranceStart.Num() == numChunks + 1 && linkOffset.Num() == numChunks + 1
+		&& nav.landmarks.count >= 0 && nav.landmarks.nodes.Num() == nav.landmarks.count
+		&& (int64)nav.landmarks.from.Num() == (int64)nav.landmarks.count * numNodes && nav.landmarks.to.Num() == nav.landmarks.from.Num()
+		&& header.sections[NAVSECTION_CHUNKENTRANCES].count == entranceStart[numChunks]
+		&& header.sections[NAVSECTION_CHUNKLINKSTART].count == entranceStart[numChunks] + numChunks
+		&& header.sections[NAVSECTION_CHUNKLINKS].count == linkOffset[numChunks]
+		&& components.nodeComponent.Num() == numNodes && components.numComponents >= 0 && components.numComponents <= numNodes
+		&& (components.reachWords == 0 || components.reachWords == (components.numComponents + 63) / 64)
+		&& (int64)components.reachBits.Num() == (int64)components.numComponents * components.reachWords;
+
+	// the chunk tables have to run forwards before the chunks can be cut out of them
+	for (int c = 0; bRead && c < numChunks; c++)
+	{
+		bRead = entranceStart[c] <= entranceStart[c + 1] && linkOffset[c] <= linkOffset[c + 1];
+	}
+	bRead = bRead && entranceStart[0] == 0 && linkOffset[0] == 0;
+
+	hier.chunks.SetNum(bRead ? numChunks : 0);
+	for (int c = 0; bRead && c < numChunks; c++)
+	{
+		NavChunk& chunk = hier.chunks[c];
+		uint32 count = entranceStart[c + 1] - entranceStart[c];
+		bRead = ReadNavSection(file, fileSize, header, NAVSECTION_CHUNKENTRANCES, chunk.entrances, entranceStart[c], count)
+			&& ReadNavSection(file, fileSize, header, NAVSECTION_CHUNKLINKSTART, chunk.linkStart, entranceStart[c] + c, count + 1)
+			&& ReadNavSection(file, fileSize, header, NAVSECTION_CHUNKLINKS, chunk.links, linkOffset[c], linkOffset[c + 1] - linkOffset[c]);
+	}
+
+	// the one pass over the whole graph, which a file cooked by the game's own build can skip
+	bool bValid = bRead && (!bValidateNavFiles || (CheckNavIndices(nav)
+		&& FCrc::MemCrc32(nav.freeBits.GetData(), nav.freeBits.Num() * sizeof(uint64)) == header.collisionCrc));
+	if (!bValid)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Nav file %s is damaged."), *filename);
+		return false;
+	}
+
+	graph = NavGraphCache::Register(key, newGraph);
+	return true;
+}
+
+// Apply a terrain edit to the rectangle (x0, z0) - (x1, z1) inclusive, newCells being its collision values row by row.
+// Only the nav points and links that can see the edit are recomputed, everything else in the graph is kept.
+void NavSystem::UpdateRegion(int x0, int z0, int x1, int z1, const std::vector<uint8>& newCells, uint32 map_version)
+{
+	NAV_TRACE_SCOPE("UpdateRegion");
+
+	if (!graph.IsValid() || x0 < 0 || z0 < 0 || x1 >= (int)mapWidth || z1 >= (int)mapHeight || x0 > x1 || z0 > z1
+		|| newCells.size() != (size_t)((x1 - x0 + 1) * (z1 - z0 + 1)))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Invalid nav update region (%d, %d) - (%d, %d)."), x0, z0, x1, z1);
+		return;
+	}
+
+	if (pathStatus == ENavPathStatus::InProgress) // a time sliced search can't carry on over a different graph
+	{
+		CancelPath();
+	}
+
+	// the same edit applied to the same graph always gives the same version, so pawns sharing
+	// a graph can find the result of whichever of them applied the edit first
+	NavGraphKey key = graph->key;
+	uint32 rect[4] = { (uint32)x0, (uint32)z0, (uint32)x1, (uint32)z1 };
+	key.mapVersion = map_version != 0 ? map_version
+		: HashCombine(key.mapVersion, FCrc::MemCrc32(newCells.data(), newCells.size(), FCrc::MemCrc32(rect, sizeof(rect))));
+
+	NavGraphPtr cached = NavGraphCache::Find(key);
+	if (cached.IsValid())
+	{
+		graph = cached;
+		return;
+	}
+
+	// patch in place if nobody else is using the graph, otherwise patch a copy
+	TSharedPtr<NavGraph, ESPMode::ThreadSafe> target;
+	if (NavGraphCache::TakeIfUnique(graph)) // it's about to stop matching its old key
+	{
+		target = ConstCastSharedPtr<NavGraph>(graph);
+	}
+	else
+	{
+		FScopeLock scopeLock(&graph->rebuildLock); // another pawn could be redoing its components or landmarks
+		target = MakeShared<NavGraph, ESPMode::ThreadSafe>(*graph);
+	}
+	NavGraph& nav = *target;
+	nav.key = key;
+	CompileJumpStencils(nav.key.jumpHeight);
+
+	int regionWidth = x1 - x0 + 1;
+	for (int z = z0; z <= z1; z++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			nav.SetFree(x, z, newCells[(z - z0) * regionWidth + (x - x0)] != 0);
+		}
+	}
+	nav.UpdateClearance(z0 - nav.key.pawnHeight, z1); // rows whose headroom reaches into the edit
+
+	// every nav point whose links could pass through or land in the edited cells:
+	// run links one cell either side, fall links from the columns either side all the way up,
+	// and anything within the jump stencils' reach, plus pawn height above and one row below for landings
+	int reachX = FPlatformMath::Max(2, jumpStencils.reachX);
+	int minX = FPlatformMath::Max(x0 - reachX, 0);
+	int maxX = FPlatformMath::Min(x1 + reachX, (int)mapWidth - 1);
+	int minZ = FPlatformMath::Max(z0 - jumpStencils.maxDz - nav.key.pawnHeight, 1);
+	int maxZ = FPlatformMath::Min(z1 - jumpStencils.minDz + 1, (int)mapHeight - 1);
+
+	updateCells.Reset();
+	for (int z = 1; z < (int)mapHeight; z++)
+	{
+		bool bJumpRows = z >= minZ && z <= maxZ;
+		int rowMinX = bJumpRows ? minX : FPlatformMath::Max(x0 - 2, 0);
+		int rowMaxX = bJumpRows ? maxX : FPlatformMath::Min(x1 + 2, (int)mapWidth - 1);
+		if (!bJumpRows && z < z0) continue; // falls only ever go down into the edit
+
+		for (int x = rowMinX; x <= rowMaxX; x++)
+		{
+			updateCells.Add(z * mapWidth + x);
+		}
+	}
+
+	// note whose incoming links are about to change
+	updateNodes.Init(0, nav.NumNodes());
+	updateTargets.Reset();
+	updateLinks.Reset();
+	for (int i = 0; i < updateCells.Num(); i++)
+	{
+		int node = nav.cellToNode[updateCells[i]];
+		if (node < 0) continue;
+
+		updateNodes[node] = 1;
+		for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+		{
+			updateTargets.Add(nav.edges[e].target);
+		}
+	}
+
+	// take the links about to be replaced out of the chunk entrance counts
+	NavHierarchy& hier = nav.hierarchy;
+	dirtyChunks.Init(0, hier.chunks.Num());
+	relinkCells.Reset();
+	crossChanges.Reset();
+	if (hier.IsBuilt())
+	{
+		for (int i = 0; i < updateCells.Num(); i++)
+		{
+			int node = nav.cellToNode[updateCells[i]];
+			if (node >= 0) CountCrossLinks(nav, node, -1);
+		}
+	}
+
+	// a cell's nav type depends on itself, the cell below and both neighbours
+	for (int z = z0; z <= FPlatformMath::Min(z1 + 1, (int)mapHeight - 1); z++)
+	{
+		for (int x = FPlatformMath::Max(x0 - 1, 0); x <= FPlatformMath::Min(x1 + 1, (int)mapWidth - 1); x++)
+		{
+			int cell = z * mapWidth + x;
+			uint8 type = ClassifyCell(nav, x, z);
+			int node = nav.cellToNode[cell];
+
+			if (node >= 0 && type == 0) // no longer standable, free up its node id
+			{
+				if (hier.IsBuilt())
+				{
+					dirtyChunks[nav.GetChunk(node)] = 1;
+					hier.entranceSlot[node] = -1;
+				}
+
+				nav.deadEdges += nav.edgeCount[node];
+				nav.edgeCount[node] = 0;
+				nav.nodeCell[node] = MAX_uint32;
+				nav.nodeType[node] = 0;
+				nav.cellToNode[cell] = -1;
+				nav.freeNodes.Add(node);
+				nav.deadReverseLinks += nav.reverseCount[node];
+				nav.reverseCount[node] = 0;
+			}
+			else if (node < 0 && type != 0) // newly standable
+			{
+				if (nav.freeNodes.Num() > 0)
+				{
+					node = nav.freeNodes.Pop(false);
+				}
+				else
+				{
+					node = nav.nodeCell.Add(0);
+					nav.nodeType.Add(0);
+					nav.edgeStart.Add(0);
+					nav.edgeCount.Add(0);
+					nav.reverseStart.Add(0);
+					nav.reverseCount.Add(0);
+					updateNodes.Add(0);
+					nav.runSkip.Add(-1);
+					nav.runSkip.Add(-1);
+
+					if (hier.IsBuilt())
+					{
+						hier.entranceSlot.Add(-1);
+						hier.crossIn.Add(0);
+					}
+				}
+				nav.nodeCell[node] = cell;
+				nav.nodeType[node] = type;
+				nav.cellToNode[cell] = node;
+
+				if (hier.IsBuilt())
+				{
+					dirtyChunks[nav.GetChunk(node)] = 1;
+				}
+			}
+			else if (node >= 0)
+			{
+				nav.nodeType[node] = type;
+			}
+		}
+	}
+
+	for (int i = 0; i < updateCells.Num(); i++)
+	{
+		int cell = updateCells[i];
+		int node = nav.cellToNode[cell];
+		if (node < 0) continue;
+
+		updatePoint.link_run.Reset();
+		updatePoint.link_fall.Reset();
+		updatePoint.link_jump.Reset();
+		CreateRunLinksAt(nav, cell, updatePoint);
+		CreateFallLinksAt(nav, cell, updatePoint);
+		CreateJumpLinksAt(nav, cell, updatePoint, updateScratch);
+
+		// the old links stay where they are until CompactEdges, so they can be compared with the new ones
+		unsigned int oldStart = nav.edgeStart[node];
+		unsigned int oldCount = nav.edgeCount[node];
+		nav.deadEdges += oldCount;
+		PackLinks(nav, node, updatePoint);
+
+		updateNodes[node] = 1;
+		for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+		{
+			NavReverseLink link = { node, e };
+			updateLinks.Add(link);
+			updateTargets.Add(nav.edges[e].target);
+		}
+
+		if (hier.IsBuilt())
+		{
+			CountCrossLinks(nav, node, 1);
+			if (ChunkLinksDiffer(nav, node, oldStart, oldCount))
+			{
+				dirtyChunks[nav.GetChunk(node)] = 1;
+			}
+		}
+	}
+
+	// nodes that started or stopped being entrances because links from other chunks came or went.
+	// Most regenerated links come back the same, so most counts end up where they started.
+	crossChanges.Sort();
+	for (int i = 0; i < crossChanges.Num(); )
+	{
+		int target = crossChanges[i] >> 1;
+		int delta = 0;
+		for (; i < crossChanges.Num() && (crossChanges[i] >> 1) == target; i++)
+		{
+			delta += (crossChanges[i] & 1) ? 1 : -1;
+		}
+
+		int crossIn = hier.crossIn[target];
+		if (nav.nodeCell[target] != MAX_uint32 && (crossIn > 0) != (crossIn - delta > 0))
+		{
+			dirtyChunks[nav.GetChunk(target)] = 1;
+			relinkCells.Add(nav.nodeCell[target]);
+		}
+	}
+
+	// redo the entrances of every chunk where any of that changed
+	for (int chunk = 0; chunk < dirtyChunks.Num(); chunk++)
+	{
+		if (dirtyChunks[chunk]) BuildChunk(nav, chunk, chunkScratch);
+	}
+
+	// then the run shortcuts of every platform with a node that may have started or stopped being a stop,
+	// in cell order so each platform is only walked once
+	relinkCells.Append(updateCells);
+	relinkCells.Sort();
+	int linkedUpTo = -1;
+	for (int i = 0; i < relinkCells.Num(); i++)
+	{
+		int cell = relinkCells[i];
+		if (cell > linkedUpTo && nav.IsNavPoint(cell))
+		{
+			linkedUpTo = LinkPlatform(nav, cell);
+		}
+	}
+
+	// patched links are appended, so squeeze out the stale ones once they outnumber the live ones.
+	// Compacting moves every edge, so the reverse links are rebuilt rather than patched then.
+	if (nav.deadEdges > nav.edges.Num() / 2)
+	{
+		CompactEdges(nav);
+		BuildReverseLinks(nav);
+	}
+	else
+	{
+		PatchReverseLinks(nav);
+		if (nav.deadReverseLinks > nav.reverseLinks.Num() / 2)
+		{
+			BuildReverseLinks(nav);
+		}
+	}
+
+	// an edit can open a shortcut, and old landmark distances would then overestimate. Redoing them is two
+	// searches of the whole graph per landmark, so queries go without until UpdateLandmarks.
+	if (nav.landmarks.count > 0)
+	{
+		FPlatformAtomics::InterlockedExchange(&nav.landmarksStale, 1);
+	}
+
+	// and join components or split them, anywhere in the graph. That costs about as much as the rest of the
+	// update put together, so it waits for the first query that needs them.
+	FPlatformAtomics::InterlockedExchange(&nav.componentsStale, 1);
+
+	graph = NavGraphCache::Register(key, target);
+}
+
+// Start a streamed world. The graph is a window max_strips * 2 strips wide, all solid until strips are attached.
+// Attaching and evicting go through UpdateRegion, so the links crossing a strip's borders are made when its
+// neighbour is there and dropped when it goes. Once a strip falls outside the window the window moves along
+// and is rebuilt from the strips still attached, leaving max_strips free slots ahead. Memory and the cost of
+// each strip only depend on max_strips, never on how far the world has scrolled.
+void NavSystem::BeginStreaming(int jump_height, int pawn_height, int strip_width, int world_height, int max_strips)
+{
+	streamStripWidth = FPlatformMath::Max(strip_width, 1);
+	streamMaxStrips = FPlatformMath::Max(max_strips, 1);
+	streamFirstStrip = 0;
+	streamOrigin = 0;
+	streamAttached.Init(0, streamMaxStrips * 2);
+
+	int width = streamStripWidth * streamAttached.Num();
+	streamCells.assign(width * world_height, 0);
+	BuildNavigation(jump_height, pawn_height, width, world_height, streamCells);
+}
+
+bool NavSystem::AttachStrip(int strip, const std::vector<uint8>& collision_strip)
+{
+	if (streamStripWidth == 0 || !graph.IsValid() || collision_strip.size() != streamStripWidth * mapHeight)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Can't attach nav strip %d."), strip);
+		return false;
+	}
+
+	// stay within max_strips, dropping whichever attached strip is furthest from the new one
+	if (!IsStripAttached(strip))
+	{
+		int attached = 0;
+		for (int slot = 0; slot < streamAttached.Num(); slot++)
+		{
+			attached += streamAttached[slot];
+		}
+
+		for (; attached >= streamMaxStrips; attached--)
+		{
+			int furthest = -1;
+			for (int slot = 0; slot < streamAttached.Num(); slot++)
+			{
+				int other = streamFirstStrip + slot;
+				if (streamAttached[slot] && (furthest < 0 || FPlatformMath::Abs(other - strip) > FPlatformMath::Abs(furthest - strip)))
+				{
+					furthest = other;
+				}
+			}
+			EvictStrip(furthest);
+		}
+	}
+
+	// off the end of the window, so move it, with the free room on the side the world is heading
+	int slots = streamAttached.Num();
+	if (strip < streamFirstStrip)
+	{
+		RebaseStream(strip - (slots - streamMaxStrips));
+	}
+	else if (strip >= streamFirstStrip + slots)
+	{
+		RebaseStream(strip - streamMaxStrips + 1);
+	}
+
+	int x0 = (strip - streamFirstStrip) * streamStripWidth;
+	UpdateRegion(x0, 0, x0 + streamStripWidth - 1, mapHeight - 1, collision_strip);
+	streamAttached[strip - streamFirstStrip] = 1;
+	return true;
+}
+
+// Fill a strip's columns in solid again, which takes its nav points and every link into them with it
+void NavSystem::EvictStrip(int strip)
+{
+	if (!IsStripAttached(strip))
+	{
+		return;
+	}
+
+	int x0 = (strip - streamFirstStrip) * streamStripWidth;
+	streamCells.assign(streamStripWidth * mapHeight, 0);
+	UpdateRegion(x0, 0, x0 + streamStripWidth - 1, mapHeight - 1, streamCells);
+	streamAttached[strip - streamFirstStrip] = 0;
+}
+
+bool NavSystem::IsStripAttached(int strip) const
+{
+	int slot = strip - streamFirstStrip;
+	return streamStripWidth > 0 && slot >= 0 && slot < streamAttached.Num() && streamAttached[slot];
+}
+
+// Move the window to start at firstStrip. Strips that would fall out of it are evicted first, which leaves every
+// column that leaves the window solid, so the rest of the graph only has to move sideways: see ShiftGraph.
+void NavSystem::RebaseStream(int firstStrip)
+{
+	int slots = streamAttached.Num();
+	for (int slot = 0; slot < slots; slot++)
+	{
+		int newSlot = streamFirstStrip + slot - firstStrip;
+		if (streamAttached[slot] && (newSlot < 0 || newSlot >= slots))
+		{
+			EvictStrip(streamFirstStrip + slot);
+		}
+	}
+
+	if (pathStatus == ENavPathStatus::InProgress) // a time sliced search can't carry on over a different graph
+	{
+		CancelPath();
+	}
+
+	int dx = (streamFirstStrip - firstStrip) * streamStripWidth; // columns everything moves right
+	TArray<uint8> attached;
+	attached.Init(0, slots);
+	for (int slot = 0; slot < slots; slot++)
+	{
+		int newSlot = streamFirstStrip + slot - firstStrip;
+		if (newSlot >= 0 && newSlot < slots) attached[newSlot] = streamAttached[slot];
+	}
+
+	streamFirstStrip = firstStrip;
+	streamOrigin = firstStrip * streamStripWidth;
+	streamAttached = MoveTemp(attached);
+
+	// the same move of the same graph always gives the same version, like an UpdateRegion edit
+	NavGraphKey key = graph->key;
+	key.mapVersion = HashCombine(key.mapVersion, GetTypeHash(dx));
+
+	NavGraphPtr cached = NavGraphCache::Find(key);
+	if (cached.IsValid())
+	{
+		graph = cached;
+		return;
+	}
+
+	TSharedPtr<NavGraph, ESPMode::ThreadSafe> target;
+	if (NavGraphCache::TakeIfUnique(graph))
+	{
+		target = ConstCastSharedPtr<NavGraph>(graph);
+	}
+	else
+	{
+		FScopeLock scopeLock(&graph->rebuildLock); // another pawn could be redoing its components or landmarks
+		target = MakeShared<NavGraph, ESPMode::ThreadSafe>(*graph);
+	}
+	target->key = key;
+	ShiftGraph(*target, dx);
+
+	graph = NavGraphCache::Register(key, target);
+}
+
+// Move every row of a cell bitmap dx columns right (left if dx is negative), solid coming in at the other side
+static void ShiftCellBits(TArray<uint64>& bits, int rowWords, int width, int dx)
+{
+	TArray<uint64> row;
+	row.SetNumUninitialized(rowWords);
+
+	for (int z = 0; z < bits.Num() / rowWords; z++)
+	{
+		uint64* out = &bits[z * rowWords];
+		FMemory::Memcpy(row.GetData(), out, rowWords * sizeof(uint64));
+
+		for (int w = 0; w < rowWords; w++)
+		{
+			// bits 64w .. 64w + 63 come from 64w - dx on, which starts at bit 'bit' of word 'word'
+			int first = w * 64 - dx;
+			int word = first >= 0 ? first / 64 : -((63 - first) / 64);
+			int bit = first - word * 64;
+			uint64 low = word >= 0 && word < rowWords ? row[word] : 0;
+			uint64 high = word + 1 >= 0 && word + 1 < rowWords ? row[word + 1] : 0;
+			out[w] = bit == 0 ? low : (low >> bit) | (high << (64 - bit));
+		}
+
+		// bits past the right edge stay solid
+		if (width & 63)
+		{
+			out[rowWords - 1] &= ((uint64)1 << (width & 63)) - 1;
+		}
+	}
+}
+
+// Move the whole graph dx columns right, for RebaseStream. Every column that leaves the map has to be solid,
+// and the ones that come in are, so no link changes: node ids, links, reverse links, landmark distances and
+// components all stay as they are, and only what holds cells moves. The chunks do too if dx is whole chunks,
+// otherwise they're cut up differently and BuildHierarchy redoes them. A pass over the cells and the nodes.
+void NavSystem::ShiftGraph(NavGraph& nav, int dx)
+{
+	NAV_TRACE_SCOPE("ShiftGraph");
+
+	int width = mapWidth;
+	ShiftCellBits(nav.freeBits, nav.rowWords, width, dx);
+	ShiftCellBits(nav.clearBits, nav.rowWords, width, dx);
+
+	TArray<int> row;
+	row.SetNumUninitialized(width);
+	for (int z = 0; z < (int)mapHeight; z++)
+	{
+		int* cells = &nav.cellToNode[z * width];
+		FMemory::Memcpy(row.GetData(), cells, width * sizeof(int));
+		for (int x = 0; x < width; x++)
+		{
+			int from = x - dx;
+			cells[x] = from >= 0 && from < width ? row[from] : -1;
+		}
+	}
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		if (nav.nodeCell[n] == MAX_uint32) continue;
+
+		nav.nodeCell[n] += dx;
+		for (unsigned int e = nav.edgeStart[n]; e < nav.edgeStart[n] + nav.edgeCount[n]; e++)
+		{
+			NavEdge& edge = nav.edges[e];
+			if (edge.bez[0] >= 0) // jump bezier control points are cells too
+			{
+				edge.bez[0] += dx;
+				edge.bez[1] += dx;
+			}
+		}
+	}
+
+	NavHierarchy& hier = nav.hierarchy;
+	if (!hier.IsBuilt())
+	{
+		return;
+	}
+	if (dx % hier.chunkSize != 0 || width % hier.chunkSize != 0)
+	{
+		BuildHierarchy(nav);
+		return;
+	}
+
+	int chunkDx = dx / hier.chunkSize;
+	TArray<NavChunk> chunks;
+	chunks.SetNum(hier.chunks.Num());
+	for (int c = 0; c < chunks.Num(); c++)
+	{
+		int from = c % hier.chunksX - chunkDx;
+		if (from >= 0 && from < hier.chunksX)
+		{
+			chunks[c] = MoveTemp(hier.chunks[c - chunkDx]);
+		}
+	}
+	hier.chunks = MoveTemp(chunks);
+}
+
+// Create a node graph describing each possible location the pawn could stand,
+// and determine whether it's at the edge or in the middle
+void NavSystem::DetectPlatforms(NavGraph& nav, const std::vector<uint8>& MapIn)
+{
+	NAV_TRACE_SCOPE("DetectPlatforms");
+
+	// 0 = no nav point
+	// 1 = platform left edge
+	// 2 = platform middle
+	// 3 = platform right edge
+	// 4 = lone platform
+
+	int mapSize = mapWidth * mapHeight;
+	int rowWords = (mapWidth + 63) / 64;
+
+	// pack the map down to one bit per cell, bits past the right edge of each row stay solid
+	nav.rowWords = rowWords;
+	nav.freeBits.Init(0, rowWords * mapHeight);
+	for (size_t z = 0; z < mapHeight; z++)
+	{
+		for (size_t x = 0; x < mapWidth; x++)
+		{
+			if (MapIn[z * mapWidth + x] != 0)
+			{
+				nav.freeBits[z * rowWords + (x >> 6)] |= (uint64)1 << (x & 63);
+			}
+		}
+	}
+	nav.UpdateClearance(0, mapHeight - 1);
+	nav.cellToNode.Init(-1, mapSize);
+
+	// classify 64 cells at a time: standable is free with solid below, and the edges
+	// fall out of comparing the standable bits with themselves shifted one cell either way
+	TArray<uint64> standable;
+	standable.SetNumUninitialized(rowWords);
+
+	for (int z = 1; z < (int)mapHeight; z++)
+	{
+		const uint64* row = &nav.freeBits[z * rowWords];
+		const uint64* rowBelow = &nav.freeBits[(z - 1) * rowWords];
+
+		for (int w = 0; w < rowWords; w++)
+		{
+			standable[w] = row[w] & ~rowBelow[w];
+		}
+
+		for (int w = 0; w < rowWords; w++)
+		{
+			uint64 bits = standable[w];
+			uint64 left = (bits << 1) | (w > 0 ? standable[w - 1] >> 63 : 0); // bit x set if x - 1 is standable
+			uint64 right = (bits >> 1) | (w + 1 < rowWords ? standable[w + 1] << 63 : 0); // bit x set if x + 1 is standable
+
+			while (bits != 0)
+			{
+				int bit = FMath::CountTrailingZeros64(bits);
+				uint64 mask = (uint64)1 << bit;
+				bits &= bits - 1;
+
+				uint8 type = 2;
+				if (!(left & mask)) type = (right & mask) ? 1 : 4;
+				else if (!(right & mask)) type = 3;
+
+				int x = w * 64 + bit;
+				int index = z * mapWidth + x;
+
+				nav.cellToNode[index] = nav.nodeCell.Add(index);
+				nav.nodeType.Add(type);
+			}
+		}
+	}
+
+	// link lists for the nav points only, air and solid cells get nothing
+	navMap.Empty();
+	navMap.SetNum(nav.NumNodes());
+}
+
+// Whether the pawn can stand in a cell, and if so where it is on its platform
+uint8 NavSystem::ClassifyCell(const NavGraph& nav, int x, int z) const
+{
+	// 0 = no nav point
+	// 1 = platform left edge
+	// 2 = platform middle
+	// 3 = platform right edge
+	// 4 = lone platform
+
+	if (!nav.IsStandable(x, z)) // target tile must be free and the one below have collision
+	{
+		return 0;
+	}
+
+	bool bLeft = nav.IsStandable(x - 1, z);
+	bool bRight = nav.IsStandable(x + 1, z);
+
+	if (!bLeft && !bRight) return 4;
+	if (!bLeft) return 1;
+	if (!bRight) return 3;
+	return 2;
+}
+
+// Split the nodes into blocks for ParallelFor. Each node only ever writes to its own navMap entry,
+// so the built graph is the same however the blocks get scheduled.
+int NavSystem::GetBuildBlocks(const NavGraph& nav, int& blockSize) const
+{
+	int blockCount = FPlatformMath::Max(1, FPlatformMisc::NumberOfCores() * 4);
+	blockSize = FPlatformMath::Max(minNodesPerBuildBlock, (nav.NumNodes() + blockCount - 1) / blockCount);
+	return (nav.NumNodes() + blockSize - 1) / blockSize;
+}
+
+void NavSystem::CreateRunLinks(const NavGraph& nav)
+{
+	NAV_TRACE_SCOPE("CreateRunLinks");
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		CreateRunLinksAt(nav, nav.nodeCell[n], navMap[n]);
+	}
+}
+
+void NavSystem::CreateRunLinksAt(const NavGraph& nav, int cell, NavPoint& point)
+{
+	int x = cell % mapWidth;
+
+	if (x > 0 && nav.IsNavPoint(cell - 1)) // not at the extreme left side
+	{
+		point.link_run.Add(cell - 1);
+	}
+
+	if (x + 1 < (int)mapWidth && nav.IsNavPoint(cell + 1)) // not at the extreme right side
+	{
+		point.link_run.Add(cell + 1);
+	}
+}
+
+void NavSystem::CreateFallLinks(const NavGraph& nav)
+{
+	NAV_TRACE_SCOPE("CreateFallLinks");
+
+	int blockSize = 0;
+	int blockCount = GetBuildBlocks(nav, blockSize);
+
+	ParallelFor(blockCount, [&](int32 block)
+	{
+		int last = FPlatformMath::Min((block + 1) * blockSize, nav.NumNodes());
+		for (int n = block * blockSize; n < last; n++)
+		{
+			CreateFallLinksAt(nav, nav.nodeCell[n], navMap[n]);
+		}
+	}, !bParallelBuild);
+}
+
+void NavSystem::CreateFallLinksAt(const NavGraph& nav, int cell, NavPoint& point)
+{
+	int a = 0, b = 0;
+	int sideX, targetRow, checkNavPoint;
+	int x = cell % mapWidth;
+	int z = cell / mapWidth;
+
+	switch (nav.nodeType[nav.GetNode(cell)])
+	{
+	case 3: //right edge
+		a = 1;
+		b = 1;
+		break;
+
+	case 1: //left edge
+		a = 0;
+		b = 0;
+		break;
+
+	case 4: // lone
+		a = 0;
+		b = 1;
+		break;
+
+	default: // middle of a platform, nowhere to fall
+		return;
+	}
+
+	for (int j = a; j <= b; j++)
+	{
+		sideX = (j == 0) ? x - 1 : x + 1; // next left or next right tile
+
+		if (nav.IsFree(sideX, z))
+		{
+			targetRow = z - 1;
+
+			while (targetRow > 0)
+			{
+				checkNavPoint = targetRow * mapWidth + sideX;
+
+				if (nav.IsNavPoint(checkNavPoint))
+				{
+					point.link_fall.Add(checkNavPoint); //add a new fall link from target navpoint to navPointToCheck
+					break;
+				}
+
+				targetRow--;
+			}
+		}
+	}
+}
+
+void NavSystem::CreateJumpLinks(const NavGraph& nav)
+{
+	NAV_TRACE_SCOPE("CreateJumpLinks");
+
+	int blockSize = 0;
+	int blockCount = GetBuildBlocks(nav, blockSize);
+
+	ParallelFor(blockCount, [&](int32 block)
+	{
+		JumpBuildScratch scratch;
+		int last = FPlatformMath::Min((block + 1) * blockSize, nav.NumNodes());
+		for (int n = block * blockSize; n < last; n++)
+		{
+			CreateJumpLinksAt(nav, nav.nodeCell[n], navMap[n], scratch);
+		}
+	}, !bParallelBuild);
+}
+
+void NavSystem::CreateJumpLinksAt(const NavGraph& nav, int cell, NavPoint& point, JumpBuildScratch& scratch) const
+{
+	int x = cell % mapWidth;
+	int z = cell / mapWidth;
+
+	// near the map borders the arcs have to be bounds checked cell by cell
+	bool bInterior = x - jumpStencils.reachX >= 0 && x + jumpStencils.reachX < (int)mapWidth
+		&& z + jumpStencils.minDz >= 0 && z + jumpStencils.maxDz < (int)mapHeight;
+
+	scratch.platformsReached.Reset();
+	scratch.reachedHeights.Reset();
+	for (int i = 0; i < jumpStencils.arcs.Num(); i++)
+	{
+		TraceJumpArc(nav, jumpStencils.arcs[i], cell, bInterior, point, scratch);
+	}
+}
+
+// Lay out every jump arc the pawn can make as a list of cells relative to its base. The arcs only depend on
+// the jump profile and map width, so they're worked out once here instead of again for every nav point.
+void NavSystem::CompileJumpStencils(int jumpHeight)
+{
+	NAV_TRACE_SCOPE("CompileJumpStencils");
+
+	if (jumpStencils.jumpHeight == jumpHeight && jumpStencils.verticalSize == verticalSize
+		&& jumpStencils.maxDropsAfterJump == (int)maxDropsAfterJump && jumpStencils.mapWidth == mapWidth)
+	{
+		return;
+	}
+
+	jumpStencils.jumpHeight = jumpHeight;
+	jumpStencils.verticalSize = verticalSize;
+	jumpStencils.maxDropsAfterJump = maxDropsAfterJump;
+	jumpStencils.mapWidth = mapWidth;
+	jumpStencils.reachX = 0;
+	jumpStencils.minDz = -(int)maxDropsAfterJump;
+	jumpStencils.maxDz = jumpHeight;
+	jumpStencils.steps.Reset();
+	jumpStencils.arcs.Reset();
+	jumpStencils.paths.Reset();
+
+	int horizontal, topDz;
+
+	// same order the arcs were always traced in, so the first arc to reach a platform still wins
+	for (int height = 1; height <= jumpHeight; height++)
+	{
+		for (int i = 0; i <= 1; i++) // left and right
+		{
+			int dir = (i == 0) ? 1 : -1;
+
+			for (int offset = height - 1; offset >= 0; offset--)
+			{
+				JumpStencil arc;
+				arc.firstStep = jumpStencils.steps.Num();
+				arc.height = height;
+				topDz = 0;
+
+				for (int f = 1; f <= offset; f++) // go up til offset height - 1
+				{
+					AddStencilStep(0, f, 0, 0, topDz, JUMPSTEP_CLEARANCE | JUMPSTEP_PATH);
+				}
+
+				// if tile above collides then is not valid
+				AddStencilStep(0, 1 + offset, 0, 0, topDz, JUMPSTEP_CLEARANCE);
+
+				horizontal = 1;
+				for (int j = 1 + offset; j <= height; j++) // go up til jump height
+				{
+					AddStencilStep(horizontal * dir, j, horizontal, height, topDz, JUMPSTEP_CLEARANCE | JUMPSTEP_PATH | JUMPSTEP_LAND);
+					horizontal++;
+				}
+
+				for (int j = 1; j <= height; j++) // go back down til level with jump start height
+				{
+					AddStencilStep(horizontal * dir, height - j, horizontal, height, topDz, JUMPSTEP_PATH | JUMPSTEP_LAND);
+					if (j < height - offset)
+					{
+						horizontal++;
+					}
+				}
+
+				for (int j = 1; j <= (int)maxDropsAfterJump; j++) // then drop straight down
+				{
+					AddStencilStep(horizontal * dir, -j, horizontal, height + j, topDz, JUMPSTEP_PATH | JUMPSTEP_LAND);
+				}
+
+				jumpStencils.reachX = FPlatformMath::Max(jumpStencils.reachX, horizontal);
+				arc.numSteps = jumpStencils.steps.Num() - arc.firstStep;
+
+				// one trajectory for the whole arc, a landing step's is as much of it as the pawn gets through
+				arc.pathStart = jumpStencils.paths.Add(0);
+				for (int s = arc.firstStep; s < arc.firstStep + arc.numSteps; s++)
+				{
+					JumpStencilStep& step = jumpStencils.steps[s];
+					if (step.flags & JUMPSTEP_PATH)
+					{
+						jumpStencils.paths.Add(step.dcell);
+					}
+					step.pathLength = jumpStencils.paths.Num() - arc.pathStart;
+				}
+
+				jumpStencils.arcs.Add(arc);
+			}
+		}
+	}
+}
+
+void NavSystem::AddStencilStep(int dx, int dz, int horizontal, int linkHeight, int& topDz, uint8 flags)
+{
+	if (flags & JUMPSTEP_PATH)
+	{
+		topDz = FPlatformMath::Max(topDz, dz);
+	}
+
+	JumpStencilStep step;
+	step.dcell = dz * (int)mapWidth + dx;
+	step.dx = dx;
+	step.dz = dz;
+	step.topDz = topDz;
+	step.flags = flags;
+	step.cost = FPlatformMath::Sqrt(FPlatformMath::Pow(horizontal, 2.0f) + FPlatformMath::Pow(linkHeight, 2.0f));
+	jumpStencils.steps.Add(step);
+}
+
+// Walk one arc from a base nav point, stopping at the first blocked cell or the first platform it reaches.
+// On a multi-profile graph a cell without the full head clearance only rules out the pawns too tall for it.
+void NavSystem::TraceJumpArc(const NavGraph& nav, const JumpStencil& arc, int base, bool bInterior, NavPoint& point, JumpBuildScratch& scratch) const
+{
+	int x = base % mapWidth;
+	int z = base / mapWidth;
+	int pawnHeight = nav.key.pawnHeight; // tallest pawn the arc has room for so far
+	const JumpStencilStep* steps = &jumpStencils.steps[arc.firstStep];
+
+	for (int s = 0; s < arc.numSteps; s++)
+	{
+		const JumpStencilStep& step = steps[s];
+		int cell = base + step.dcell;
+		int cx = x + step.dx;
+		int cz = z + step.dz;
+
+		bool bOpen;
+		if (bInterior)
+		{
+			// head clearance is its own bitmap, so either test is a single bit
+			const TArray<uint64>& bits = (step.flags & JUMPSTEP_CLEARANCE) ? nav.clearBits : nav.freeBits;
+			bOpen = ((bits[cz * nav.rowWords + (cx >> 6)] >> (cx & 63)) & 1) != 0;
+		}
+		else
+		{
+			bOpen = (step.flags & JUMPSTEP_CLEARANCE) ? nav.HasClearance(cx, cz) : nav.IsFree(cx, cz);
+		}
+
+		if (!bOpen)
+		{
+			if (!nav.key.bMultiProfile || !(step.flags & JUMPSTEP_CLEARANCE) || !nav.IsFree(cx, cz)) return;
+			pawnHeight = FPlatformMath::Min(pawnHeight, nav.GetHeadroom(cx, cz));
+		}
+
+		if ((step.flags & JUMPSTEP_LAND) && nav.IsNavPoint(cell))
+		{
+			// the first arc to reach a platform is the one a pawn takes, so a later one is only
+			// linked for the pawns too tall for every arc before it
+			int slot = scratch.platformsReached.Find(cell);
+			int linkedHeight = slot != INDEX_NONE ? scratch.reachedHeights[slot] : -1;
+			if (pawnHeight > linkedHeight)
+			{
+				AddJumpLink(cell, base, arc, step, linkedHeight + 1, pawnHeight, point);
+				if (slot == INDEX_NONE)
+				{
+					scratch.platformsReached.Add(cell);
+					scratch.reachedHeights.Add(pawnHeight);
+				}
+				else
+				{
+					scratch.reachedHeights[slot] = pawnHeight;
+				}
+			}
+			return;
+		}
+	}
+}
+
+void NavSystem::AddJumpLink(int target, int base, const JumpStencil& arc, const JumpStencilStep& step, int minPawnHeight, int maxPawnHeight, NavPoint& point) const
+{
+	JumpInfo& newJump = point.link_jump[point.link_jump.AddDefaulted()];
+	newJump.index = target;
+
+	// bezier control points sit level with the top of the arc, above the start and the landing point
+	int newZ = (base / mapWidth + step.topDz) * mapWidth;
+	newJump.bez[0] = newZ + base % mapWidth;
+	newJump.bez[1] = newZ + target % mapWidth;
+
+	// the trajectory is the stencil's, shared with every other jump along this arc
+	newJump.pathStart = arc.pathStart;
+	newJump.pathLength = step.pathLength;
+
+	newJump.jump_cost = step.cost;
+	newJump.jumpHeight = arc.height;
+	newJump.minPawnHeight = minPawnHeight;
+	newJump.maxPawnHeight = maxPawnHeight;
+
+	//UE_LOG(LogTemp, Error, TEXT("add jump from %d to %d (cost %f)"), base, target, step.cost);
+}
+
+// Pack the per-cell build data into the compact graph the search runs on, then free it
+void NavSystem::FinalizeGraph(NavGraph& nav)
+{
+	NAV_TRACE_SCOPE("FinalizeGraph");
+
+	// count links so the edge arrays are allocated once
+	int edgeCount = 0;
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		const NavPoint& point = navMap[n];
+		edgeCount += point.link_run.Num() + point.link_fall.Num() + point.link_jump.Num();
+	}
+
+	nav.edgeStart.SetNumZeroed(nav.NumNodes());
+	nav.edgeCount.SetNumZeroed(nav.NumNodes());
+	nav.edges.Reserve(edgeCount);
+	nav.jumpPathPool = jumpStencils.paths;
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		PackLinks(nav, n, navMap[n]);
+	}
+
+	BuildReverseLinks(nav);
+	navMap.Empty();
+}
+
+// Index every link by its target, for searches that run backwards from a goal. Falls and most jumps
+// only go one way, so this can't be read off the forward links.
+void NavSystem::BuildReverseLinks(NavGraph& nav)
+{
+	nav.reverseStart.Init(0, nav.NumNodes());
+	nav.reverseCount.Init(0, nav.NumNodes());
+	nav.reverseLinks.SetNumUninitialized(nav.edges.Num() - nav.deadEdges);
+	nav.deadReverseLinks = 0;
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		for (unsigned int e = nav.edgeStart[n]; e < nav.edgeStart[n] + nav.edgeCount[n]; e++)
+		{
+			nav.reverseCount[nav.edges[e].target]++;
+		}
+	}
+
+	unsigned int start = 0;
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		nav.reverseStart[n] = start;
+		start += nav.reverseCount[n];
+		nav.reverseCount[n] = 0;
+	}
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		for (unsigned int e = nav.edgeStart[n]; e < nav.edgeStart[n] + nav.edgeCount[n]; e++)
+		{
+			int target = nav.edges[e].target;
+			NavReverseLink& link = nav.reverseLinks[nav.reverseStart[target] + nav.reverseCount[target]++];
+			link.source = n;
+			link.edge = e;
+		}
+	}
+}
+
+// Rewrite the reverse links of every node UpdateRegion changed the incoming links of. Links from nodes it
+// didn't touch are kept, the rest come from updateLinks, and the new lists go on the end like PackLinks does.
+void NavSystem::PatchReverseLinks(NavGraph& nav)
+{
+	updateTargets.Sort();
+	updateLinks.Sort([&nav](const NavReverseLink& a, const NavReverseLink& b)
+	{
+		return nav.edges[a.edge].target < nav.edges[b.edge].target;
+	});
+
+	int nextLink = 0;
+	for (int i = 0; i < updateTargets.Num(); i++)
+	{
+		int target = updateTargets[i];
+		if (i > 0 && updateTargets[i - 1] == target) continue;
+
+		unsigned int start = nav.reverseLinks.Num();
+		unsigned int oldEnd = nav.reverseStart[target] + nav.reverseCount[target];
+		for (unsigned int r = nav.reverseStart[target]; r < oldEnd; r++)
+		{
+			NavReverseLink link = nav.reverseLinks[r];
+			if (!updateNodes[link.source]) nav.reverseLinks.Add(link);
+		}
+
+		while (nextLink < updateLinks.Num() && (int)nav.edges[updateLinks[nextLink].edge].target < target) nextLink++;
+		while (nextLink < updateLinks.Num() && (int)nav.edges[updateLinks[nextLink].edge].target == target)
+		{
+			nav.reverseLinks.Add(updateLinks[nextLink++]);
+		}
+
+		nav.deadReverseLinks += nav.reverseCount[target];
+		nav.reverseStart[target] = start;
+		nav.reverseCount[target] = nav.reverseLinks.Num() - start;
+	}
+}
+
+// Append a nav point's links to the end of the edge arrays and point the node at them
+void NavSystem::PackLinks(NavGraph& nav, int node, const NavPoint& point)
+{
+	int z = nav.nodeCell[node] / mapWidth;
+
+	nav.edgeStart[node] = nav.edges.Num();
+	nav.edgeCount[node] = point.link_run.Num() + point.link_fall.Num() + point.link_jump.Num();
+
+	NavEdge edge;
+	edge.bez[0] = -1;
+	edge.bez[1] = -1;
+	edge.pathStart = 0;
+	edge.pathLength = 0;
+	edge.jumpHeight = 0; // runs and falls are the same for every pawn
+	edge.minPawnHeight = 0;
+	edge.maxPawnHeight = MAX_uint8;
+
+	// run links
+	edge.kind = 1;
+	edge.cost = 1.0f;
+	for (int j = 0; j < point.link_run.Num(); j++)
+	{
+		edge.target = nav.cellToNode[point.link_run[j]];
+		nav.edges.Add(edge);
+	}
+
+	// fall links, straight line cost from the edge down to the landing point
+	edge.kind = 2;
+	for (int j = 0; j < point.link_fall.Num(); j++)
+	{
+		int landingZ = point.link_fall[j] / mapWidth;
+		edge.target = nav.cellToNode[point.link_fall[j]];
+		edge.cost = 1.0f;
+		if (z > landingZ)
+		{
+			edge.cost = FPlatformMath::Sqrt(1.0f + FPlatformMath::Pow(z - landingZ, 2.0f));
+		}
+		nav.edges.Add(edge);
+	}
+
+	// jump links, trajectories are already in the pool
+	edge.kind = 3;
+	for (int j = 0; j < point.link_jump.Num(); j++)
+	{
+		const JumpInfo& jump = point.link_jump[j];
+		edge.target = nav.cellToNode[jump.index];
+		edge.cost = jump.jump_cost;
+		edge.bez[0] = jump.bez[0];
+		edge.bez[1] = jump.bez[1];
+		edge.pathStart = jump.pathStart;
+		edge.pathLength = jump.pathLength;
+		edge.jumpHeight = jump.jumpHeight;
+		edge.minPawnHeight = jump.minPawnHeight;
+		edge.maxPawnHeight = jump.maxPawnHeight;
+		nav.edges.Add(edge);
+	}
+}
+
+// Rewrite the edge arrays without the ranges orphaned by UpdateRegion
+void NavSystem::CompactEdges(NavGraph& nav)
+{
+	TArray<NavEdge> edges;
+	edges.Reserve(nav.edges.Num() - nav.deadEdges);
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		unsigned int start = edges.Num();
+		edges.Append(nav.edges.GetData() + nav.edgeStart[n], nav.edgeCount[n]);
+		nav.edgeStart[n] = start;
+	}
+
+	nav.edges = MoveTemp(edges);
+	nav.deadEdges = 0;
+}
+
+// Run shortcuts: on a long platform most cells only have run links to their neighbours, so the search
+// can go straight from one cell that matters to the next instead of expanding every cell between.
+// A node is a stop if it's a platform edge, has a fall or jump of its own, or is a chunk entrance. Landing spots
+// don't need to be, the search reaches them through the fall or jump itself and carries on from there.
+bool NavSystem::IsRunStop(const NavGraph& nav, int node) const
+{
+	if (nav.nodeType[node] != 2 || (nav.hierarchy.IsBuilt() && nav.hierarchy.entranceSlot[node] >= 0))
+	{
+		return true;
+	}
+
+	int cell = nav.nodeCell[node];
+	for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+	{
+		const NavEdge& edge = nav.edges[e];
+		if (edge.kind == 1) continue;
+
+		// a hop to somewhere further along the same platform is never cheaper than running there
+		int target = nav.nodeCell[edge.target];
+		int step = target > cell ? 1 : -1;
+		if (target / mapWidth == cell / mapWidth && edge.cost >= FPlatformMath::Abs(target - cell))
+		{
+			int c = cell + step;
+			while (c != target && nav.IsNavPoint(c)) c += step;
+			if (c == target) continue;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void NavSystem::LinkPlatforms(NavGraph& nav)
+{
+	NAV_TRACE_SCOPE("LinkPlatforms");
+
+	nav.runSkip.Init(-1, nav.NumNodes() * 2);
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		if (nav.nodeType[n] == 1 || nav.nodeType[n] == 4) // walk each platform once from its left end
+		{
+			LinkPlatform(nav, nav.nodeCell[n]);
+		}
+	}
+}
+
+// Point every node on the platform through cell at the nearest stop either side of it.
+// Returns the cell at the right end of the platform.
+int NavSystem::LinkPlatform(NavGraph& nav, int cell)
+{
+	int rowStart = cell - cell % mapWidth;
+	int first = cell, last = cell;
+	while (first > rowStart && nav.IsNavPoint(first - 1)) first--;
+	while (last + 1 < rowStart + (int)mapWidth && nav.IsNavPoint(last + 1)) last++;
+
+	int stop = -1;
+	for (int c = first; c <= last; c++)
+	{
+		int node = nav.cellToNode[c];
+		nav.runSkip[node * 2] = stop;
+		if (IsRunStop(nav, node)) stop = node;
+	}
+
+	stop = -1;
+	for (int c = last; c >= first; c--)
+	{
+		int node = nav.cellToNode[c];
+		nav.runSkip[node * 2 + 1] = stop;
+		if (IsRunStop(nav, node)) stop = node;
+	}
+
+	return last;
+}
+
+// Cut the map into chunks and work out the entrance costs of each. Chunks are independent of each other,
+// so they're built in parallel once the cross-chunk links have been counted.
+void NavSystem::BuildHierarchy(NavGraph& nav)
+{
+	NAV_TRACE_SCOPE("BuildHierarchy");
+
+	NavHierarchy& hier = nav.hierarchy;
+	hier = NavHierarchy();
+
+	// entrance costs would mix links no one pawn can take together
+	int chunkSize = nav.key.chunkSize;
+	if (chunkSize <= 0 || nav.key.bMultiProfile)
+	{
+		return;
+	}
+
+	int chunksX = (mapWidth + chunkSize - 1) / chunkSize;
+	int chunksZ = (mapHeight + chunkSize - 1) / chunkSize;
+	if (chunksX < 3 && chunksZ < 3) // small enough that no query would use it
+	{
+		return;
+	}
+
+	hier.chunkSize = chunkSize;
+	hier.chunksX = chunksX;
+	hier.chunksZ = chunksZ;
+	hier.chunks.SetNum(chunksX * chunksZ);
+	hier.entranceSlot.Init(-1, nav.NumNodes());
+	hier.crossIn.Init(0, nav.NumNodes());
+
+	for (int n = 0; n < nav.NumNodes(); n++)
+	{
+		if (nav.nodeCell[n] == MAX_uint32) continue;
+
+		int chunk = nav.GetChunk(n);
+		for (unsigned int e = nav.edgeStart[n]; e < nav.edgeStart[n] + nav.edgeCount[n]; e++)
+		{
+			if (nav.GetChunk(nav.edges[e].target) != chunk)
+			{
+				hier.crossIn[nav.edges[e].target]++;
+			}
+		}
+	}
+
+	int blockCount = FPlatformMath::Min(hier.chunks.Num(), FPlatformMath::Max(1, FPlatformMisc::NumberOfCores() * 4));
+	int blockSize = (hier.chunks.Num() + blockCount - 1) / blockCount;
+
+	ParallelFor(blockCount, [&](int32 block)
+	{
+		ChunkSearchScratch scratch;
+		int last = FPlatformMath::Min((block + 1) * blockSize, hier.chunks.Num());
+		for (int chunk = block * blockSize; chunk < last; chunk++)
+		{
+			BuildChunk(nav, chunk, scratch);
+		}
+	}, !bParallelBuild);
+}
+
+// Place count landmarks for the ALT heuristic and store every node's distances to and from them.
+// Landmarks go far apart: each new one is the node furthest from the nearest one placed so far,
+// which puts them at the ends of the map where the bounds they give are tightest. On a multi-profile graph the
+// distances are over every link, they're still lower bounds for a pawn that can only take some of them.
+void NavSystem::BuildLandmarks(const NavGraph& nav, int count) const
+{
+	NAV_TRACE_SCOPE("BuildLandmarks");
+
+	NavLandmarks& out = nav.landmarks;
+	out.count = 0;
+	out.nodes.Reset();
+	out.from.Reset();
+	out.to.Reset();
+
+	int nodeCount = nav.NumNodes();
+	int seed = 0;
+	while (seed < nodeCount && nav.nodeCell[seed] == MAX_uint32)
+	{
+		seed++;
+	}
+	if (count <= 0 || seed == nodeCount)
+	{
+		return;
+	}
+
+	TArray<float> dist[2];
+	TArray<NavQueueItem> queue[2];
+	TArray<float> nearest; // per node, distance either way to the closest landmark so far
+	nearest.Init(MAX_flt, nodeCount);
+
+	// the first landmark is the node furthest from an arbitrary one
+	SearchLandmark(nav, seed, false, dist[0], queue[0]);
+	int next = seed;
+	for (int n = 0; n < nodeCount; n++)
+	{
+		if (dist[0][n] < MAX_flt && dist[0][n] > dist[0][next]) next = n;
+	}
+
+	out.from.Init(MAX_flt, nodeCount * count);
+	out.to.Init(MAX_flt, nodeCount * count);
+
+	for (int k = 0; k < count; k++)
+	{
+		out.nodes.Add(next);
+
+		ParallelFor(2, [&](int32 side)
+		{
+			SearchLandmark(nav, next, side == 1, dist[side], queue[side]);
+		}, !bParallelBuild);
+
+		// only nodes some landmark can reach or be reached from are candidates, the rest are on islands of their own
+		int furthest = -1;
+		for (int n = 0; n < nodeCount; n++)
+		{
+			out.from[n * count + k] = dist[0][n];
+			out.to[n * count + k] = dist[1][n];
+			nearest[n] = FPlatformMath::Min(nearest[n], FPlatformMath::Min(dist[0][n], dist[1][n]));
+
+			if (nearest[n] < MAX_flt && (furthest < 0 || nearest[n] > nearest[furthest]))
+			{
+				furthest = n;
+			}
+		}
+		next = furthest;
+	}
+
+	out.count = count;
+}
+
+// Dijkstra over the whole graph from one node, or towards it over the reverse links
+void NavSystem::SearchLandmark(const NavGraph& nav, int source, bool bReverse, TArray<float>& dist, TArray<NavQueueItem>& queue) const
+{
+	dist.Init(MAX_flt, nav.NumNodes());
+	queue.Reset();
+	dist[source] = 0.0f;
+	queue.HeapPush({ 0.0f, source });
+
+	while (queue.Num() > 0)
+	{
+		NavQueueItem item;
+		queue.HeapPop(item, false);
+		if (item.cost > dist[item.index]) continue; // stale entry, already settled cheaper
+
+		if (bReverse)
+		{
+			unsigned int linkEnd = nav.reverseStart[item.index] + nav.reverseCount[item.index];
+			for (unsigned int r = nav.reverseStart[item.index]; r < linkEnd; r++)
+			{
+				const NavReverseLink& link = nav.reverseLinks[r];
+				float cost = item.cost + nav.edges[link.edge].cost;
+				if (cost < dist[link.source])
+				{
+					dist[link.source] = cost;
+					queue.HeapPush({ cost, link.source });
+				}
+			}
+		}
+		else
+		{
+			unsigned int edgeEnd = nav.edgeStart[item.index] + nav.edgeCount[item.index];
+			for (unsigned int e = nav.edgeStart[item.index]; e < edgeEnd; e++)
+			{
+				float cost = item.cost + nav.edges[e].cost;
+				if (cost < dist[nav.edges[e].target])
+				{
+					dist[nav.edges[e].target] = cost;
+					queue.HeapPush({ cost, (int)nav.edges[e].target });
+				}
+			}
+		}
+	}
+}
+
+// Strongly connected components of the graph (Tarjan's, without recursion), then the components each one can reach.
+// Tarjan finishes a component only after every component reachable from it, so numbering them in that order makes
+// every link go to the same or a lower one, and the reach sets can be filled in from component 0 up in one pass.
+void NavSystem::BuildComponents(const NavGraph& nav) const
+{
+	NAV_TRACE_SCOPE("BuildComponents");
+
+	NavComponents& out = nav.components;
+	int numNodes = nav.NumNodes();
+	out.numComponents = 0;
+	out.nodeComponent.Init(-1, numNodes);
+
+	TArray<int> order; // per node, when the walk first got there, -1 if it hasn't
+	TArray<int> low; // per node, earliest order reachable through nodes still on the stack
+	TArray<unsigned int> nextEdge; // per node on the walk, its next link to follow
+	TArray<int> stack; // nodes whose component isn't finished yet
+	TArray<int> walk; // the current path of the depth first walk
+	order.Init(-1, numNodes);
+	low.SetNumUninitialized(numNodes);
+	nextEdge.SetNumUninitialized(numNodes);
+	int visited = 0;
+
+	for (int root = 0; root < numNodes; root++)
+	{
+		if (order[root] >= 0 || nav.nodeCell[root] == MAX_uint32) continue;
+
+		order[root] = low[root] = visited++;
+		nextEdge[root] = nav.edgeStart[root];
+		stack.Add(root);
+		walk.Add(root);
+
+		while (walk.Num() > 0)
+		{
+			int node = walk.Last();
+			if (nextEdge[node] < nav.edgeStart[node] + nav.edgeCount[node])
+			{
+				int target = nav.edges[nextEdge[node]++].target;
+				if (order[target] < 0)
+				{
+					order[target] = low[target] = visited++;
+					nextEdge[target] = nav.edgeStart[target];
+					stack.Add(target);
+					walk.Add(target);
+				}
+				else if (out.nodeComponent[target] < 0) // still on the stack
+				{
+					low[node] = FPlatformMath::Min(low[node], order[target]);
+				}
+				continue;
+			}
+
+			walk.Pop(false);
+			if (walk.Num() > 0)
+			{
+				low[walk.Last()] = FPlatformMath::Min(low[walk.Last()], low[node]);
+			}
+
+			// nothing below node leads back above it, so node and everything after it on the stack are one component
+			if (low[node] == order[node])
+			{
+				int member;
+				do
+				{
+					member = stack.Pop(false);
+					out.nodeComponent[member] = out.numComponents;
+				} while (member != node);
+				out.numComponents++;
+			}
+		}
+	}
+
+	out.reachWords = 0;
+	out.reachBits.Empty();
+	if (out.numComponents > nav.key.maxReachComponents)
+	{
+		return;
+	}
+
+	// members of each component, to find the links out of it
+	TArray<int> memberStart;
+	TArray<int> members;
+	memberStart.Init(0, out.numComponents + 1);
+	for (int n = 0; n < numNodes; n++)
+	{
+		if (out.nodeComponent[n] >= 0) memberStart[out.nodeComponent[n] + 1]++;
+	}
+	for (int c = 0; c < out.numComponents; c++)
+	{
+		memberStart[c + 1] += memberStart[c];
+	}
+	members.SetNumUninitialized(memberStart[out.numComponents]);
+	for (int n = 0; n < numNodes; n++)
+	{
+		if (out.nodeComponent[n] >= 0) members[memberStart[out.nodeComponent[n]]++] = n;
+	}
+	for (int c = out.numComponents; c > 0; c--)
+	{
+		memberStart[c] = memberStart[c - 1];
+	}
+	memberStart[0] = 0;
+
+	int words = (out.numComponents + 63) / 64;
+	out.reachWords = words;
+	out.reachBits.Init(0, out.numComponents * words);
+
+	for (int c = 0; c < out.numComponents; c++)
+	{
+		uint64* reach = &out.reachBits[c * words];
+		reach[c >> 6] |= (uint64)1 << (c & 63);
+
+		for (int m = memberStart[c]; m < memberStart[c + 1]; m++)
+		{
+			int node = members[m];
+			for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+			{
+				// a component already in the set brought everything it reaches with it
+				int other = out.nodeComponent[nav.edges[e].target];
+				if ((reach[other >> 6] >> (other & 63)) & 1) continue;
+
+				// and only reaches lower components, so only the words up to its own can have bits set
+				const uint64* otherReach = &out.reachBits[other * words];
+				for (int w = 0; w <= (other >> 6); w++)
+				{
+					reach[w] |= otherReach[w];
+				}
+			}
+		}
+	}
+}
+
+// Redo the components of a graph UpdateRegion left them stale on. It can be shared by then, so whichever
+// NavSystem gets to it first does it under the graph's rebuildLock, and MightReach says yes to everything until it's done.
+void NavSystem::UpdateComponents() const
+{
+	const NavGraph& nav = *graph;
+	if (!FPlatformAtomics::AtomicRead(&nav.componentsStale))
+	{
+		return;
+	}
+
+	FScopeLock scopeLock(&nav.rebuildLock);
+	if (FPlatformAtomics::AtomicRead(&nav.componentsStale)) // not done while this waited for the lock
+	{
+		BuildComponents(nav);
+		FPlatformAtomics::InterlockedExchange(&nav.componentsStale, 0);
+	}
+}
+
+// Redo the landmarks of a graph UpdateRegion left them stale on, under the graph's rebuildLock like UpdateComponents.
+// Queries that start before it's done search with the plain heuristic, so it can run on another thread while they go on.
+void NavSystem::UpdateLandmarks() const
+{
+	const NavGraph& nav = *graph;
+	if (!FPlatformAtomics::AtomicRead(&nav.landmarksStale))
+	{
+		return;
+	}
+
+	FScopeLock scopeLock(&nav.rebuildLock);
+	if (FPlatformAtomics::AtomicRead(&nav.landmarksStale))
+	{
+		BuildLandmarks(nav, nav.landmarks.count);
+		FPlatformAtomics::InterlockedExchange(&nav.landmarksStale, 0);
+	}
+}
+
+// The nav point closest to goalCell that startNode might reach, for bNearestReachableGoal. -1 if there isn't one
+// within query.nearestGoalRadius cells. Looks in square rings outwards from the goal, and nothing on ring r is
+// closer than r, so it stops at the first ring past the best one found.
+int NavSystem::FindNearestReachable(int startNode, int goalCell) const
+{
+	int goalX = goalCell % mapWidth;
+	int goalZ = goalCell / mapWidth;
+	int best = -1;
+	int64 bestDistance = MAX_int64;
+
+	for (int r = 0; r <= query.nearestGoalRadius && (int64)r * r < bestDistance; r++)
+	{
+		for (int dz = -r; dz <= r; dz++)
+		{
+			int z = goalZ + dz;
+			if (z < 0 || z >= (int)mapHeight) continue;
+
+			// the top and bottom rows of the ring whole, the rows between only at their two ends
+			int step = dz == -r || dz == r ? 1 : 2 * r;
+			for (int dx = -r; dx <= r; dx += step)
+			{
+				int x = goalX + dx;
+				if (x < 0 || x >= (int)mapWidth) continue;
+
+				int node = graph->GetNode(z * mapWidth + x);
+				int64 distance = (int64)dx * dx + (int64)dz * dz;
+				if (node >= 0 && distance < bestDistance && graph->MightReach(startNode, node))
+				{
+					bestDistance = distance;
+					best = node;
+				}
+			}
+		}
+	}
+
+	return best;
+}
+
+// Find a chunk's entrances and the in-chunk cost between every pair of them
+void NavSystem::BuildChunk(NavGraph& nav, int chunk, ChunkSearchScratch& scratch) const
+{
+	NavHierarchy& hier = nav.hierarchy;
+	NavChunk& data = hier.chunks[chunk];
+
+	// ids UpdateRegion freed or moved to another chunk have already been cleared
+	for (int i = 0; i < data.entrances.Num(); i++)
+	{
+		int node = data.entrances[i];
+		if (nav.nodeCell[node] != MAX_uint32 && nav.GetChunk(node) == chunk)
+		{
+			hier.entranceSlot[node] = -1;
+		}
+	}
+	data.entrances.Reset();
+
+	GatherChunk(nav, chunk, false, scratch);
+
+	for (int i = 0; i < scratch.nodes.Num(); i++)
+	{
+		int node = scratch.nodes[i];
+		bool bEntrance = hier.crossIn[node] > 0;
+
+		for (unsigned int e = nav.edgeStart[node]; !bEntrance && e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+		{
+			bEntrance = nav.GetChunk(nav.edges[e].target) != chunk;
+		}
+
+		if (bEntrance)
+		{
+			hier.entranceSlot[node] = data.entrances.Add(node);
+		}
+	}
+
+	int count = data.entrances.Num();
+	data.linkStart.SetNumUninitialized(count + 1);
+	data.links.Reset();
+
+	for (int i = 0; i < count; i++)
+	{
+		SearchChunk(nav, data.entrances[i], count, scratch);
+		data.linkStart[i] = data.links.Num();
+
+		for (int j = 0; j < count; j++)
+		{
+			int local = scratch.GetLocal(nav.nodeCell[data.entrances[j]], mapWidth);
+			if (j != i && scratch.dist[local] < MAX_flt && !scratch.viaEntrance[local])
+			{
+				data.links.Add({ data.entrances[j], scratch.dist[local] });
+			}
+		}
+	}
+	data.linkStart[count] = data.links.Num();
+}
+
+// Add (delta 1) or take away (delta -1) a node's links to other chunks from their targets' counts.
+// Each change goes in crossChanges as target * 2, plus 1 when adding, for UpdateRegion to net them out.
+void NavSystem::CountCrossLinks(NavGraph& nav, int node, int delta)
+{
+	int chunk = nav.GetChunk(node);
+
+	for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+	{
+		int target = nav.edges[e].target;
+		if (nav.GetChunk(target) != chunk)
+		{
+			nav.hierarchy.crossIn[target] += delta;
+			crossChanges.Add(target * 2 + (delta > 0 ? 1 : 0));
+		}
+	}
+}
+
+// Whether a node's chunk would see its links differently from the ones at [oldStart, oldStart + oldCount),
+// which UpdateRegion just replaced: a link inside the chunk added, dropped or changed, or the node gaining
+// its first link out of the chunk or losing its last, which makes it an entrance or stops it being one.
+// Link generation is deterministic, so links that didn't change come back in the same order.
+bool NavSystem::ChunkLinksDiffer(const NavGraph& nav, int node, unsigned int oldStart, unsigned int oldCount) const
+{
+	int chunk = nav.GetChunk(node);
+	unsigned int oldLink = oldStart, oldEnd = oldStart + oldCount;
+	unsigned int newLink = nav.edgeStart[node], newEnd = newLink + nav.edgeCount[node];
+	bool bOldCross = false, bNewCross = false;
+
+	while (true)
+	{
+		// on to the next link inside the chunk on each side
+		for (; oldLink < oldEnd && nav.GetChunk(nav.edges[oldLink].target) != chunk; oldLink++) bOldCross = true;
+		for (; newLink < newEnd && nav.GetChunk(nav.edges[newLink].target) != chunk; newLink++) bNewCross = true;
+		if (oldLink == oldEnd || newLink == newEnd) break;
+
+		if (nav.edges[oldLink].target != nav.edges[newLink].target || nav.edges[oldLink].cost != nav.edges[newLink].cost)
+		{
+			return true;
+		}
+		oldLink++;
+		newLink++;
+	}
+
+	return oldLink != oldEnd || newLink != newEnd || bOldCross != bNewCross;
+}
+
+// List the nodes inside a chunk and the links between them, grouped by source or for backwards searches by target.
+// The searches then run on local indices without looking anything up in the graph.
+void NavSystem::GatherChunk(const NavGraph& nav, int chunk, bool bReverse, ChunkSearchScratch& scratch) const
+{
+	const NavHierarchy& hier = nav.hierarchy;
+
+	scratch.x0 = (chunk % hier.chunksX) * hier.chunkSize;
+	scratch.z0 = (chunk / hier.chunksX) * hier.chunkSize;
+	scratch.x1 = FPlatformMath::Min(scratch.x0 + hier.chunkSize, (int)mapWidth);
+	scratch.z1 = FPlatformMath::Min(scratch.z0 + hier.chunkSize, (int)mapHeight);
+
+	int width = scratch.x1 - scratch.x0;
+	scratch.localIndex.Init(-1, width * (scratch.z1 - scratch.z0));
+	scratch.nodes.Reset();
+
+	for (int z = scratch.z0; z < scratch.z1; z++)
+	{
+		for (int x = scratch.x0; x < scratch.x1; x++)
+		{
+			int node = nav.cellToNode[z * mapWidth + x];
+			if (node >= 0)
+			{
+				scratch.localIndex[(z - scratch.z0) * width + (x - scratch.x0)] = scratch.nodes.Add(node);
+			}
+		}
+	}
+
+	int nodeCount = scratch.nodes.Num();
+	scratch.linkStart.SetNumUninitialized(nodeCount + 1);
+	scratch.linkNode.Reset();
+	scratch.linkCost.Reset();
+
+	if (!bReverse)
+	{
+		// already in source order
+		for (int i = 0; i < nodeCount; i++)
+		{
+			int node = scratch.nodes[i];
+			scratch.linkStart[i] = scratch.linkNode.Num();
+			for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+			{
+				int target = scratch.GetLocal(nav.nodeCell[nav.edges[e].target], mapWidth);
+				if (target < 0) continue;
+
+				scratch.linkNode.Add(target);
+				scratch.linkCost.Add(nav.edges[e].cost);
+			}
+		}
+		scratch.linkStart[nodeCount] = scratch.linkNode.Num();
+		return;
+	}
+
+	// counting sort of the in-chunk links by target
+	for (int i = 0; i <= nodeCount; i++)
+	{
+		scratch.linkStart[i] = 0;
+	}
+	for (int i = 0; i < nodeCount; i++)
+	{
+		int node = scratch.nodes[i];
+		for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+		{
+			int target = scratch.GetLocal(nav.nodeCell[nav.edges[e].target], mapWidth);
+			if (target >= 0) scratch.linkStart[target + 1]++;
+		}
+	}
+
+	for (int i = 0; i < nodeCount; i++)
+	{
+		scratch.linkStart[i + 1] += scratch.linkStart[i];
+	}
+
+	int linkCount = scratch.linkStart[nodeCount];
+	scratch.linkNode.SetNumUninitialized(linkCount);
+	scratch.linkCost.SetNumUninitialized(linkCount);
+
+	for (int i = 0; i < nodeCount; i++)
+	{
+		int node = scratch.nodes[i];
+		for (unsigned int e = nav.edgeStart[node]; e < nav.edgeStart[node] + nav.edgeCount[node]; e++)
+		{
+			int target = scratch.GetLocal(nav.nodeCell[nav.edges[e].target], mapWidth);
+			if (target < 0) continue;
+
+			int slot = scratch.linkStart[target]++;
+			scratch.linkNode[slot] = i;
+			scratch.linkCost[slot] = nav.edges[e].cost;
+		}
+	}
+
+	// the fill pass moved every start along to the next one's, so shift them back
+	for (int i = nodeCount; i > 0; i--)
+	{
+		scratch.linkStart[i] = scratch.linkStart[i - 1];
+	}
+	scratch.linkStart[0] = 0;
+}
+
+// Cheapest costs from source to every entrance of the gathered chunk without leaving it, or from every entrance
+// to source if it was gathered backwards. Stops once numEntrances entrances have been settled, the other nodes'
+// costs are only what they were at that point. Returns how many nodes it settled.
+int NavSystem::SearchChunk(const NavGraph& nav, int source, int numEntrances, ChunkSearchScratch& scratch) const
+{
+	scratch.dist.Init(MAX_flt, scratch.nodes.Num());
+	scratch.viaEntrance.Init(0, scratch.nodes.Num());
+	scratch.queue.Reset();
+
+	int sourceLocal = scratch.GetLocal(nav.nodeCell[source], mapWidth);
+	scratch.dist[sourceLocal] = 0.0f;
+	scratch.queue.HeapPush({ 0.0f, sourceLocal });
+	int settled = 0;
+	int settledEntrances = 0;
+
+	while (scratch.queue.Num() > 0)
+	{
+		NavQueueItem item;
+		scratch.queue.HeapPop(item, false);
+		if (item.cost > scratch.dist[item.index]) continue; // stale entry, already settled cheaper
+
+		settled++;
+		int node = scratch.nodes[item.index];
+		bool bEntrance = nav.hierarchy.entranceSlot[node] >= 0;
+		if (bEntrance && ++settledEntrances == numEntrances)
+		{
+			break;
+		}
+
+		uint8 via = scratch.viaEntrance[item.index] || (node != source && bEntrance);
+		for (unsigned int l = scratch.linkStart[item.index]; l < scratch.linkStart[item.index + 1]; l++)
+		{
+			int other = scratch.linkNode[l];
+			float cost = item.cost + scratch.linkCost[l];
+			if (cost < scratch.dist[other])
+			{
+				scratch.dist[other] = cost;
+				scratch.viaEntrance[other] = via;
+				scratch.queue.HeapPush({ cost, other });
+			}
+		}
+	}
+
+	return settled;
+}
+
+// Worth going through the hierarchy if start and goal aren't in the same or neighbouring chunks
+bool NavSystem::IsLongQuery(int startNode, int goalNode) const
+{
+	const NavHierarchy& hier = graph->hierarchy;
+	if (!hier.IsBuilt())
+	{
+		return false;
+	}
+
+	int startChunk = graph->GetChunk(startNode);
+	int goalChunk = graph->GetChunk(goalNode);
+
+	return FPlatformMath::Abs(startChunk % hier.chunksX - goalChunk % hier.chunksX) > 1
+		|| FPlatformMath::Abs(startChunk / hier.chunksX - goalChunk / hier.chunksX) > 1;
+}
+
+// A* over the chunk entrances from startIndex to goalIndex, a slice at a time like ExpandPathT. The chunks the
+// cheapest route passes through are stamped into corridorStamp, the search proper then only has to refine inside them.
+// Hooking start and goal onto their chunks is a Dijkstra over the whole chunk each, so a slice can overrun its
+// budget by up to a chunk's nodes. expanded gets the nodes this slice used. Found once the corridor is stamped,
+// Failed if the goal can't be reached at all. bLandmarks as for ExpandPathT.
+template <bool bLandmarks>
+ENavPathStatus NavSystem::ExpandCorridor(int maxExpansions, double deadline, int& expanded)
+{
+	const NavHierarchy& hier = graph->hierarchy;
+	int goalChunk = graph->GetChunk(goalIndex);
+	expanded = 0;
+
+	// hook start and goal onto the entrances of their own chunks
+	if (corridorState == 1)
+	{
+		if (maxExpansions <= 0)
+		{
+			return ENavPathStatus::InProgress;
+		}
+
+		int startChunk = graph->GetChunk(startIndex);
+		GatherChunk(*graph, startChunk, false, chunkScratch);
+		expanded += SearchChunk(*graph, startIndex, hier.chunks[startChunk].entrances.Num(), chunkScratch);
+		corridorState = 2;
+	}
+
+	if (corridorState == 2)
+	{
+		if (expanded >= maxExpansions || (deadline > 0.0 && expanded > 0 && FPlatformTime::Seconds() >= deadline))
+		{
+			return ENavPathStatus::InProgress;
+		}
+
+		GatherChunk(*graph, goalChunk, true, goalChunkScratch);
+		expanded += SearchChunk(*graph, goalIndex, hier.chunks[goalChunk].entrances.Num(), goalChunkScratch);
+
+		ResetSearchState();
+		GetSearchNode(goalIndex);
+		PathNode& startNode = GetSearchNode(startIndex);
+		startNode.G = 0.0f;
+		startNode.H = GetHeuristicT<NavEuclideanHeuristic, bLandmarks>(startIndex);
+		OpenListPush(startIndex);
+		corridorState = 3;
+	}
+
+	for (; openList.Num() > 0; expanded++)
+	{
+		if (expanded >= maxExpansions || (deadline > 0.0 && expanded > 0 && (expanded & 15) == 0 && FPlatformTime::Seconds() >= deadline))
+		{
+			return ENavPathStatus::InProgress;
+		}
+
+		int current = GetNextNode();
+		float currentCost = searchNodes[current].G;
+		int chunk = graph->GetChunk(current);
+
+		if (current == goalIndex)
+		{
+			if (corridorStamp.Num() < hier.chunks.Num())
+			{
+				corridorStamp.SetNumZeroed(hier.chunks.Num());
+			}
+
+			corridorId++;
+			if (corridorId == 0) // wrapped
+			{
+				for (int i = 0; i < corridorStamp.Num(); i++)
+				{
+					corridorStamp[i] = 0;
+				}
+				corridorId = 1;
+			}
+
+			for (int node = current; node >= 0; node = searchNodes[node].parent)
+			{
+				corridorStamp[graph->GetChunk(node)] = corridorId;
+			}
+
+			corridorState = 0;
+			return ENavPathStatus::Found;
+		}
+
+		// across the chunk to its other entrances
+		const NavChunk& data = hier.chunks[chunk];
+		if (current == startIndex)
+		{
+			for (int j = 0; j < data.entrances.Num(); j++)
+			{
+				int local = chunkScratch.GetLocal(graph->nodeCell[data.entrances[j]], mapWidth);
+				if (chunkScratch.dist[local] < MAX_flt && !chunkScratch.viaEntrance[local])
+				{
+					AddAbstractNode<bLandmarks>(data.entrances[j], chunkScratch.dist[local], current);
+				}
+			}
+		}
+		else
+		{
+			int slot = hier.entranceSlot[current];
+			for (unsigned int l = data.linkStart[slot]; l < data.linkStart[slot + 1]; l++)
+			{
+				AddAbstractNode<bLandmarks>(data.links[l].target, currentCost + data.links[l].cost, current);
+			}
+		}
+
+		// out into the neighbouring chunks
+		for (unsigned int e = graph->edgeStart[current]; e < graph->edgeStart[current] + graph->edgeCount[current]; e++)
+		{
+			const NavEdge& edge = graph->edges[e];
+			if (graph->GetChunk(edge.target) != chunk)
+			{
+				AddAbstractNode<bLandmarks>(edge.target, currentCost + edge.cost, current);
+			}
+		}
+
+		// and from an entrance of the goal's chunk to the goal
+		if (chunk == goalChunk)
+		{
+			int local = goalChunkScratch.GetLocal(graph->nodeCell[current], mapWidth);
+			if (goalChunkScratch.dist[local] < MAX_flt && !goalChunkScratch.viaEntrance[local])
+			{
+				AddAbstractNode<bLandmarks>(goalIndex, currentCost + goalChunkScratch.dist[local], current);
+			}
+		}
+	}
+
+	UE_LOG(LogTemp, Error, TEXT("No path to goal found."));
+	return ENavPathStatus::Failed;
+}
+
+template <bool bLandmarks>
+void NavSystem::AddAbstractNode(int index, float newCost, int parent)
+{
+	PathNode& node = GetSearchNode(index);
+
+	if (node.state == 2 || (node.state == 1 && newCost >= node.G))
+	{
+		return;
+	}
+
+	node.G = newCost;
+	node.parent = parent;
+
+	if (node.state == 1)
+	{
+		OpenListSiftUp(node.heapIndex);
+		NAV_STAT(queryStats.decreaseKeys++);
+	}
+	else
+	{
+		node.H = GetHeuristicT<NavEuclideanHeuristic, bLandmarks>(index);
+		OpenListPush(index);
+	}
+}
+
+void NavSystem::SetStartAndGoal(int start_x, int start_z, int goal_x, int goal_z)
+{
+	int mapSize = mapWidth * mapHeight;
+	int startCell = start_z * mapWidth + start_x;
+	int goalCell = goal_z * mapWidth + goal_x;
+
+	if (start_x >= 0 && start_z >= 0 && goal_x >= 0 && goal_z >= 0
+		&& startCell < mapSize && goalCell < mapSize
+		&& graph->IsNavPoint(startCell) && graph->IsNavPoint(goalCell)) // only standable cells are in the graph
+	{
+		startIndex = graph->GetNode(startCell);
+		goalIndex = graph->GetNode(goalCell);
+
+		bBidirectionalSearch = query.bBidirectional && searchPolicy.bBidirectional;
+		bLandmarkSearch = graph->HasLandmarks(); // for the whole query, UpdateLandmarks could finish partway
+
+		// long queries find their route through the chunk hierarchy first, then only refine the chunks on it.
+		// That's searched from StepPath too, see ExpandCorridor.
+		bCorridorSearch = searchPolicy.bWholeGraph && IsLongQuery(startIndex, goalIndex);
+		corridorState = bCorridorSearch ? 1 : 0;
+		if (!bCorridorSearch)
+		{
+			SetSearchStart();
+		}
+		
+		//UE_LOG(LogTemp, Error, TEXT("Set start (%d, %d) and goal (%d, %d)"), start_x, start_z, goal_x, goal_z);
+	}
+}
+
+// Seed the search from startIndex, once the corridor is stamped if there is one
+void NavSystem::SetSearchStart()
+{
+	ResetSearchState();
+
+	if (bBidirectionalSearch)
+	{
+		SetBidirectionalStart();
+		return;
+	}
+
+	// the search loop for the rest of the query, so it doesn't have to ask per link
+	int landmarks = bLandmarkSearch ? 1 : 0;
+	searchLoop = (query.bContractRuns ? 1 : 0) + (bCorridorSearch ? 2 : 0) + landmarks * 4;
+
+	GetSearchNode(goalIndex); // stamped now so its coords are there for GetHeuristicT
+	PathNode& startNode = GetSearchNode(startIndex);
+	startNode.G = 0.0f; // costs 0 to get to start from start
+	startNode.H = (this->*searchPolicy.heuristic[landmarks])(startIndex); // estimated cost to get from start to end
+	startNode.parent = -1; // first cell has no parent
+	startNode.edge = -1;
+	startNode.type = 0;
+	startNode.bez[0] = -1;
+	startNode.bez[1] = -1;
+	startNode.directions.Reset();
+
+	OpenListPush(startIndex); // add start cell to openList
+}
+
+// Expand nodes until the goal comes off the open list or the open list runs dry
+void NavSystem::CheckPath()
+{
+	ExpandPath(MAX_int32, 0.0);
+}
+
+// The unidirectional loop is instantiated per search policy, see ExpandPathT. A long query's corridor
+// search comes out of the same budget, and the search proper gets what it leaves.
+ENavPathStatus NavSystem::ExpandPath(int maxExpansions, double deadline)
+{
+	if (corridorState != 0)
+	{
+		int expanded = 0;
+		ENavPathStatus corridor = bLandmarkSearch ? ExpandCorridor<true>(maxExpansions, deadline, expanded)
+			: ExpandCorridor<false>(maxExpansions, deadline, expanded);
+		if (corridor != ENavPathStatus::Found)
+		{
+			return corridor;
+		}
+
+		SetSearchStart();
+		maxExpansions -= expanded;
+	}
+
+	if (bBidirectionalSearch)
+	{
+		return bCorridorSearch ? ExpandBidirectional<true>(maxExpansions, deadline) : ExpandBidirectional<false>(maxExpansions, deadline);
+	}
+
+	return (this->*searchPolicy.expand[searchLoop])(maxExpansions, deadline);
+}
+
+// Move backwards from the goal finding the shortest path back to start, only these nodes get their directions
+void NavSystem::CollectPath()
+{
+	for (int getPath = goalIndex; getPath >= 0; getPath = searchNodes[getPath].parent)
+	{
+		PathNode& pathNode = searchNodes[getPath];
+		if (pathNode.parent >= 0)
+		{
+			SetPathStep(pathNode);
+		}
+
+		pathNodesToGoal.Add(&pathNode);
+	}
+}
+
+// Raise estimate h using the landmarks. The triangle inequality gives two lower bounds per landmark L:
+// d(L, goal) - d(L, node) and d(node, L) - d(goal, L). All of them are admissible if h is, so the largest is too.
+float NavSystem::GetLandmarkBound(int index, float h) const
+{
+	int count = graph->landmarks.count;
+	const float* from = &graph->landmarks.from[index * count];
+	const float* to = &graph->landmarks.to[index * count];
+	const float* goalFrom = &graph->landmarks.from[goalIndex * count];
+	const float* goalTo = &graph->landmarks.to[goalIndex * count];
+
+	for (int k = 0; k < count; k++)
+	{
+		// a landmark that can't reach (or be reached from) either end says nothing
+		if (goalFrom[k] < MAX_flt && from[k] < MAX_flt)
+		{
+			h = FPlatformMath::Max(h, goalFrom[k] - from[k]);
+		}
+		if (to[k] < MAX_flt && goalTo[k] < MAX_flt)
+		{
+			h = FPlatformMath::Max(h, to[k] - goalTo[k]);
+		}
+	}
+
+	return h;
+}
+
+// Seed both sides of a bidirectional search, the arena has just been reset
+void NavSystem::SetBidirectionalStart()
+{
+	if (bidiNodes.Num() < graph->NumNodes())
+	{
+		NAV_STAT(queryStats.allocations++);
+		bidiNodes.SetNum(graph->NumNodes());
+	}
+
+	bidiBest = MAX_flt;
+	bidiMeet = -1;
+	AddBidirectionalNode(0, startIndex, 0.0f, -1, -1);
+	AddBidirectionalNode(1, goalIndex, 0.0f, -1, -1);
+}
+
+// Bidirectional A* over the forward links and the reverse ones. Each side runs on the average of the two
+// heuristics (potential = (h_goal - h_start) / 2, negated going backwards), which keeps the reduced link
+// costs the same both ways and never negative while the straight line distance stays a lower bound on
+// every link. The search can then stop as soon as the two queue tops add up to the best route found
+// where the sides touch, it can't improve after that. Expands the side with the smaller queue.
+// bInCorridor is bCorridorSearch, a template parameter so the links aren't checked against it one by one.
+template <bool bInCorridor>
+ENavPathStatus NavSystem::ExpandBidirectional(int maxExpansions, double deadline)
+{
+	for (int expanded = 0; ; expanded++)
+	{
+		// drop entries for nodes that were closed since they were queued
+		for (int side = 0; side < 2; side++)
+		{
+			TArray<NavQueueItem>& queue = bidiQueue[side];
+			while (queue.Num() > 0 && bidiNodes[queue.HeapTop().index].state[side] == 2)
+			{
+				NavQueueItem item;
+				queue.HeapPop(item, false);
+			}
+		}
+
+		if (bidiQueue[0].Num() == 0 || bidiQueue[1].Num() == 0
+			|| bidiQueue[0].HeapTop().cost + bidiQueue[1].HeapTop().cost >= bidiBest)
+		{
+			break;
+		}
+
+		if (expanded >= maxExpansions || (deadline > 0.0 && expanded > 0 && (expanded & 15) == 0 && FPlatformTime::Seconds() >= deadline))
+		{
+			return ENavPathStatus::InProgress;
+		}
+
+		int side = bidiQueue[0].Num() <= bidiQueue[1].Num() ? 0 : 1;
+		NavQueueItem item;
+		bidiQueue[side].HeapPop(item, false);
+		int current = item.index;
+		BidirectionalNode& currentNode = bidiNodes[current];
+		currentNode.state[side] = 2;
+		NAV_STAT(queryStats.expanded++);
+
+		if (side == 0)
+		{
+			unsigned int edgeEnd = graph->edgeStart[current] + graph->edgeCount[current];
+			for (unsigned int e = graph->edgeStart[current]; e < edgeEnd; e++)
+			{
+				int target = graph->edges[e].target;
+				if (graph->edges[e].Fits(jumpHeight, verticalSize) && !(bInCorridor && corridorStamp[graph->GetChunk(target)] != corridorId))
+				{
+					AddBidirectionalNode(0, target, currentNode.G[0] + graph->edges[e].cost, current, e);
+				}
+			}
+		}
+		else
+		{
+			unsigned int linkEnd = graph->reverseStart[current] + graph->reverseCount[current];
+			for (unsigned int r = graph->reverseStart[current]; r < linkEnd; r++)
+			{
+				const NavReverseLink& link = graph->reverseLinks[r];
+				if (graph->edges[link.edge].Fits(jumpHeight, verticalSize) && !(bInCorridor && corridorStamp[graph->GetChunk(link.source)] != corridorId))
+				{
+					AddBidirectionalNode(1, link.source, currentNode.G[1] + graph->edges[link.edge].cost, current, link.edge);
+				}
+			}
+		}
+	}
+
+	if (bidiMeet < 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No path to goal found."));
+		return ENavPathStatus::Failed;
+	}
+
+	BuildBidirectionalPath();
+	return ENavPathStatus::Found;
+}
+
+// Arena record for a node, cleared first if it was last touched by an earlier query
+BidirectionalNode& NavSystem::GetBidirectionalNode(int index)
+{
+	BidirectionalNode& node = bidiNodes[index];
+
+	if (node.searchId != searchId)
+	{
+		int cell = graph->nodeCell[index];
+		int x = cell % mapWidth, z = cell / mapWidth;
+		int goalCell = graph->nodeCell[goalIndex], startCell = graph->nodeCell[startIndex];
+		float toGoal = FPlatformMath::Sqrt(FPlatformMath::Pow(x - (int)(goalCell % mapWidth), 2.0f) + FPlatformMath::Pow(z - (int)(goalCell / mapWidth), 2.0f));
+		float toStart = FPlatformMath::Sqrt(FPlatformMath::Pow(x - (int)(startCell % mapWidth), 2.0f) + FPlatformMath::Pow(z - (int)(startCell / mapWidth), 2.0f));
+
+		node.potential = 0.5f * (toGoal - toStart);
+		node.searchId = searchId;
+		node.state[0] = 0;
+		node.state[1] = 0;
+	}
+
+	return node;
+}
+
+// Reach a node from one side, newCost being its distance from the start (side 0) or to the goal (side 1)
+void NavSystem::AddBidirectionalNode(int side, int index, float newCost, int parent, int edge)
+{
+	BidirectionalNode& node = GetBidirectionalNode(index);
+
+	if (node.state[side] == 2 || (node.state[side] == 1 && newCost >= node.G[side]))
+	{
+		return;
+	}
+
+	NAV_STAT(queryStats.decreaseKeys += node.state[side] == 1); // queued again, the old entry is skipped later
+	NAV_STAT(queryStats.allocations += bidiQueue[side].Num() == bidiQueue[side].Max());
+
+	node.G[side] = newCost;
+	node.parent[side] = parent;
+	node.edge[side] = edge;
+	node.state[side] = 1;
+	bidiQueue[side].HeapPush({ newCost + (side == 0 ? node.potential : -node.potential), index });
+	NAV_STAT(queryStats.openPeak = FPlatformMath::Max(queryStats.openPeak, bidiQueue[0].Num() + bidiQueue[1].Num()));
+
+	// the other side has been here, so this is a whole route
+	if (node.state[1 - side] != 0 && newCost + node.G[1 - side] < bidiBest)
+	{
+		bidiBest = newCost + node.G[1 - side];
+		bidiMeet = index;
+	}
+}
+
+// Turn the route through bidiMeet into search nodes, so GetPath reads it like one from CheckPath
+void NavSystem::BuildBidirectionalPath()
+{
+	PathNode& startNode = GetSearchNode(startIndex);
+	startNode.G = 0.0f;
+	startNode.H = 0.0f;
+	startNode.parent = -1;
+	startNode.edge = -1;
+	startNode.type = 0;
+	startNode.bez[0] = -1;
+	startNode.bez[1] = -1;
+	startNode.directions.Reset();
+
+	// links in start to goal order, the forward half is read off backwards
+	TArray<int>& route = bidiRoute;
+	route.Reset();
+	for (int n = bidiMeet; n != startIndex; n = bidiNodes[n].parent[0])
+	{
+		route.Add(bidiNodes[n].edge[0]);
+	}
+	for (int i = 0, j = route.Num() - 1; i < j; i++, j--)
+	{
+		route.Swap(i, j);
+	}
+	for (int n = bidiMeet; n != goalIndex; n = bidiNodes[n].parent[1])
+	{
+		route.Add(bidiNodes[n].edge[1]);
+	}
+
+	int from = startIndex;
+	for (int i = 0; i < route.Num(); i++)
+	{
+		const NavEdge& edge = graph->edges[route[i]];
+		PathNode& node = GetSearchNode(edge.target);
+
+		node.G = searchNodes[from].G + edge.cost;
+		node.H = 0.0f;
+		node.parent = from;
+		node.edge = route[i];
+		SetPathStep(node);
+
+		from = edge.target;
+	}
+
+	for (int getPath = goalIndex; getPath >= 0; getPath = searchNodes[getPath].parent)
+	{
+		pathNodesToGoal.Add(&searchNodes[getPath]);
+	}
+}
+
+int NavSystem::GetNextNode() // takes the node with the lowest F value off the top of openList
+{
+	int nextNode = OpenListPop();
+	searchNodes[nextNode].state = 2; // closed, never reopened
+	NAV_STAT(queryStats.expanded++); // corridor searches count too
+
+	return nextNode;
+}
+
+// Type, bezier points and cell by cell directions of a node on the found path, from the edge it was reached by
+void NavSystem::SetPathStep(PathNode& node) const
+{
+	int fromCell = searchNodes[node.parent].index;
+	node.directions.Reset(); // keeps its allocation from earlier queries
+
+	// runs and run shortcuts go along the platform a cell at a time
+	if (node.edge < 0 || graph->edges[node.edge].kind == 1)
+	{
+		node.type = 1;
+		node.bez[0] = -1;
+		node.bez[1] = -1;
+
+		int step = node.index > fromCell ? 1 : -1;
+		for (int cell = fromCell; cell != node.index; cell += step)
+		{
+			node.directions.Add(cell);
+		}
+		node.directions.Add(node.index);
+		return;
+	}
+
+	const NavEdge& edge = graph->edges[node.edge];
+	node.type = edge.kind;
+	node.bez[0] = edge.bez[0];
+	node.bez[1] = edge.bez[1];
+	GetLinkDirections(fromCell, edge, node.directions);
+}
+
+// Start a new query. The arena only grows when the graph gains nodes,
+// otherwise bumping searchId invalidates every record from the last query.
+void NavSystem::ResetSearchState()
+{
+	int nodeCount = graph->NumNodes();
+
+	if (searchNodes.Num() < nodeCount)
+	{
+		NAV_STAT(queryStats.allocations++);
+		searchNodes.SetNum(nodeCount);
+	}
+
+	searchId++;
+	if (searchId == 0) // wrapped, so old stamps could look current again
+	{
+		for (int i = 0; i < searchNodes.Num(); i++)
+		{
+			searchNodes[i].searchId = 0;
+		}
+		for (int i = 0; i < bidiNodes.Num(); i++)
+		{
+			bidiNodes[i].searchId = 0;
+		}
+		searchId = 1;
+	}
+
+	openList.Reset();
+	bidiQueue[0].Reset();
+	bidiQueue[1].Reset();
+	pathNodesToGoal.Reset();
+}
+
+// Arena record for a node, cleared first if it was last touched by an earlier query
+PathNode& NavSystem::GetSearchNode(int index)
+{
+	PathNode& node = searchNodes[index];
+
+	if (node.searchId != searchId)
+	{
+		int cell = graph->nodeCell[index];
+		node.SetCoords(cell % mapWidth, cell / mapWidth, cell);
+		node.searchId = searchId;
+		node.state = 0;
+		node.heapIndex = -1;
+		node.parent = -1;
+	}
+
+	return node;
+}
+
+void NavSystem::OpenListPush(int index)
+{
+	NAV_STAT(queryStats.allocations += openList.Num() == openList.Max());
+
+	int heapPos = openList.Add(index);
+	searchNodes[index].heapIndex = heapPos;
+	searchNodes[index].state = 1; // open
+	OpenListSiftUp(heapPos);
+
+	NAV_STAT(queryStats.openPeak = FPlatformMath::Max(queryStats.openPeak, openList.Num()));
+}
+
+int NavSystem::OpenListPop()
+{
+	int top = openList[0];
+	int last = openList.Pop(false);
+
+	if (openList.Num() > 0) // move last node to the root and let it sink back into place
+	{
+		openList[0] = last;
+		searchNodes[last].heapIndex = 0;
+		OpenListSiftDown(0);
+	}
+
+	searchNodes[top].heapIndex = -1;
+	return top;
+}
+
+void NavSystem::OpenListSiftUp(int heapPos)
+{
+	int node = openList[heapPos];
+	float nodeF = searchNodes[node].GetF();
+
+	while (heapPos > 0)
+	{
+		int parentPos = (heapPos - 1) / 2;
+		if (searchNodes[openList[parentPos]].GetF() <= nodeF) break;
+
+		openList[heapPos] = openList[parentPos]; // pull parent down into the gap
+		searchNodes[openList[heapPos]].heapIndex = heapPos;
+		heapPos = parentPos;
+	}
+
+	openList[heapPos] = node;
+	searchNodes[node].heapIndex = heapPos;
+}
+
+void NavSystem::OpenListSiftDown(int heapPos)
+{
+	int node = openList[heapPos];
+	float nodeF = searchNodes[node].GetF();
+	int count = openList.Num();
+
+	while (true)
+	{
+		int childPos = heapPos * 2 + 1;
+		if (childPos >= count) break;
+
+		// pick the smaller of the two children
+		if (childPos + 1 < count && searchNodes[openList[childPos + 1]].GetF() < searchNodes[openList[childPos]].GetF())
+		{
+			childPos++;
+		}
+
+		if (nodeF <= searchNodes[openList[childPos]].GetF()) break;
+
+		openList[heapPos] = openList[childPos]; // pull child up into the gap
+		searchNodes[openList[heapPos]].heapIndex = heapPos;
+		heapPos = childPos;
+	}
+
+	openList[heapPos] = node;
+	searchNodes[node].heapIndex = heapPos;
+}
+
+FVector NavSystem::FindPath(FVector start, FVector goal)
+{
+	FVector goalLocation = BeginPath(start, goal);
+	StepPath(MAX_int32); // the whole search in one go
+	return goalLocation; // return world location for start and goal
+}
+
+// Set a query up without expanding anything, StepPath then does the searching a slice at a time,
+// a long query's corridor search included. The open and closed lists stay in the arena between slices.
+FVector NavSystem::BeginPath(FVector start, FVector goal)
+{
+	// Remove old
+	DeletePath();
+	pathStatus = ENavPathStatus::Failed;
+
+#if NAV_INSTRUMENTATION
+	queryStats = NavQueryStats();
+	queryStats.start = FPlatformTime::Seconds();
+#endif
+
+	if (!graph.IsValid())
+	{
+		return FVector::ZeroVector;
+	}
+
+	int start_x, start_z, goal_x, goal_z;
+	if (!SnapStart(start, start_x, start_z) || !SnapGoal(goal, goal_x, goal_z))
+	{
+		return FVector::ZeroVector;
+	}
+
+	// If start or goal is colliding then can't return the location
+	if (!graph->IsFree(start_x, start_z) || !graph->IsFree(goal_x, goal_z))
+	{
+		return FVector::ZeroVector;
+	}
+	
+	// a goal start can't lead to would otherwise only be found out by searching everywhere start can get to
+	UpdateComponents();
+	bool bReachable = true;
+	int startCell = start_z * mapWidth + start_x;
+	int goalCell = goal_z * mapWidth + goal_x;
+	if (graph->IsNavPoint(startCell))
+	{
+		int startNode = graph->GetNode(startCell);
+		bReachable = graph->IsNavPoint(goalCell) && graph->MightReach(startNode, graph->GetNode(goalCell));
+
+		int nearest = !bReachable && query.bNearestReachableGoal ? FindNearestReachable(startNode, goalCell) : -1;
+		if (nearest >= 0)
+		{
+			goal_x = graph->nodeCell[nearest] % mapWidth;
+			goal_z = graph->nodeCell[nearest] / mapWidth;
+			bReachable = true;
+		}
+	}
+
+	pathGoal = FVector((goal_x + streamOrigin) * (int)cellSize + (cellSize / 2), 32.0f, (goal_z + 1) * cellSize);
+
+	if (!bReachable)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No path to goal found."));
+		NAV_STAT(queryStats.searchTime = FPlatformTime::Seconds() - queryStats.start);
+		NAV_STAT(RecordQuery(false));
+		return pathGoal;
+	}
 
-void NavSystem::CreateRunLinks()
-{
-	int mapSize = mapWidth * mapHeight;
-	for (size_t i = 0; i < mapSize; i++)
+	// the same query on the same version of the map has been answered before
+	pathKey = { graph->key, start_z * (int)mapWidth + start_x, goal_z * (int)mapWidth + goal_x, searchPolicy.id, jumpHeight, verticalSize };
+	if (query.bUsePathCache && NavPathCache::Find(pathKey, cachedPath))
 	{
-		// not at the extreme right side
-		if (navMap[i].nav_type != 0 && (i + 1) % mapWidth != 0)
-		{
-			if (navMap[i + 1].nav_type != 0)
-			{
-				navMap[i].link_run.Add(i + 1); // add a new floor link from target navpoint to next right navpoint
-				navMap[i + 1].link_run.Add(i); // and in reverse, so you can go left
-			}
-		}
+		RestorePath(cachedPath);
+		pathStatus = cachedPath.results[0].numSteps > 0 ? ENavPathStatus::Found : ENavPathStatus::Failed;
+		NAV_STAT(queryStats.searchTime = FPlatformTime::Seconds() - queryStats.start);
+		NAV_STAT(RecordQuery(true));
+		return pathGoal;
 	}
+
+	SetStartAndGoal(start_x, start_z, goal_x, goal_z); // initialise start and goal points
+	pathStatus = ENavPathStatus::InProgress;
+	NAV_STAT(queryStats.searchTime = FPlatformTime::Seconds() - queryStats.start);
+	return pathGoal;
 }
 
-void NavSystem::CreateFallLinks()
+// Carry on the search BeginPath set up for up to maxExpansions nodes or maxMicroseconds, whichever runs out first
+ENavPathStatus NavSystem::StepPath(int maxExpansions, double maxMicroseconds)
 {
-	int mapSize = mapWidth * mapHeight;
-	int a = 0, b = 0;
-	int sideTile, targetRow, checkNavPoint;
-	for (size_t i = 0; i < mapSize; i++)
+	if (pathStatus != ENavPathStatus::InProgress)
 	{
-		if (navMap[i].nav_type == 1 || navMap[i].nav_type == 3 || navMap[i].nav_type == 4) // left edge / right edge / lone
-		{
-			switch (navMap[i].nav_type)
-			{
-			case 3: //right edge
-				a = 1;
-				b = 1;
-				break;
-
-			case 1: //left edge
-				a = 0;
-				b = 0;
-				break;
+		return pathStatus;
+	}
 
-			case 4: // lone
-				a = 0;
-				b = 1;
-				break;
+	NAV_STAT(double sliceStart = FPlatformTime::Seconds());
+	double deadline = maxMicroseconds > 0.0 ? FPlatformTime::Seconds() + maxMicroseconds * 0.000001 : 0.0;
+	pathStatus = ExpandPath(maxExpansions, deadline);
+	NAV_STAT(queryStats.searchTime += FPlatformTime::Seconds() - sliceStart);
 
-			default:
-				break;
-			}
+	if (pathStatus != ENavPathStatus::InProgress && query.bUsePathCache)
+	{
+		cachedPath.Reset();
+		AppendPath(pathGoal, cachedPath);
+		NavPathCache::Add(pathKey, cachedPath);
+	}
 
-			for (size_t j = a; j <= b; j++)
-			{
-				if (j == 0)
-				{
-					sideTile = i - 1; //sideTile = next left tile
-				}
-				else
-				{
-					sideTile = i + 1; //sideTile = next right tile
-				}
-				
-				if (navMap[sideTile].collision == 1)
-				{
-					targetRow = navMap[sideTile].z_coord - 1;
+#if NAV_INSTRUMENTATION
+	if (pathStatus != ENavPathStatus::InProgress)
+	{
+		RecordQuery(false);
+	}
+#endif
 
-					while (targetRow > 0)
-					{
-						checkNavPoint = targetRow * mapWidth + navMap[sideTile].x_coord;
+	return pathStatus;
+}
 
-						if (navMap[checkNavPoint].nav_type != 0)
-						{
-							navMap[i].link_fall.Add(checkNavPoint); //add a new fall link from target navpoint to navPointToCheck
-							break;
-						}
+#if NAV_INSTRUMENTATION
+// One FindPath event from queryStats. Its duration is the time spent in BeginPath and StepPath,
+// wall_ms also counts the frames in between for a time sliced query.
+void NavSystem::RecordQuery(bool bCacheHit)
+{
+	NavTraceEvent event;
+	event.name = TEXT("FindPath");
+	event.start = queryStats.start;
+	event.duration = queryStats.searchTime;
+	event.AddArg(TEXT("expanded"), queryStats.expanded);
+	event.AddArg(TEXT("open_peak"), queryStats.openPeak);
+	event.AddArg(TEXT("decrease_keys"), queryStats.decreaseKeys);
+	event.AddArg(TEXT("path_length"), pathNodesToGoal.Num());
+	event.AddArg(TEXT("cost"), pathNodesToGoal.Num() > 0 ? pathNodesToGoal[0]->G : -1.0);
+	event.AddArg(TEXT("allocations"), queryStats.allocations);
+	event.AddArg(TEXT("wall_ms"), (FPlatformTime::Seconds() - queryStats.start) * 1000.0);
+	event.AddArg(TEXT("cache_hit"), bCacheHit ? 1.0 : 0.0);
+	NavTrace::Record(event);
+}
+#endif
 
-						targetRow--;
-					}
-				}
-			}
-		}
-	}
+// Drop a time sliced query, finished or not
+void NavSystem::CancelPath()
+{
+	DeletePath();
 }
 
-void NavSystem::CreateJumpLinks(int jumpHeight)
+// Cell a pawn at start is standing in, false if it's off the map
+bool NavSystem::SnapStart(FVector start, int& start_x, int& start_z) const
 {
-	int mapSize = mapWidth * mapHeight;
-	for (size_t i = 0; i < mapSize; i++)
+	start_x = FPlatformMath::FloorToInt(start.X / cellSize) - streamOrigin;
+	start_z = FPlatformMath::FloorToInt(start.Z / cellSize) - 1;
+	int start_index = start_z * mapWidth + start_x;
+
+	if (start_x < 0 || start_x >= (int)mapWidth || start_z < 0 || start_index >= graph->NumCells())
+	{
+		return false;
+	}
+
+	if (!graph->IsNavPoint(start_index)) // if start colliding, find nearest available nav point above (max 1 off)
 	{
-		if (navMap[i].nav_type != 0)
+		if (start_index + (int)mapWidth < graph->NumCells())
 		{
-			platformsReached.Empty();
-			for (size_t j = 1; j <= jumpHeight; j++)
+			if (graph->IsNavPoint(start_index + mapWidth))
 			{
-				CalculateJumpAtPoint(j, i);
+				start_z++;
 			}
 		}
 	}
+
+	return true;
 }
 
-void NavSystem::CalculateJumpAtPoint(int height, int base)
+// Cell to path to for a goal location, false if it's off the map
+bool NavSystem::SnapGoal(FVector goal, int& goal_x, int& goal_z) const
 {
-	if (base >= navMap.Num()) { return; }
-	
-	int x = navMap[base].x_coord;
-	int z = navMap[base].z_coord;
-	int index = 0, horizontal;
-	bool bLeft;
-	TArray<unsigned int> path;
-	bool bSkip;
+	goal_x = FPlatformMath::FloorToInt(goal.X / cellSize) - streamOrigin;
+	goal_z = FPlatformMath::FloorToInt(goal.Z / cellSize);
+	int goal_index = goal_z * mapWidth + goal_x;
 
-	for (int i = 0; i <= 1; i++) // left and right
+	if (goal_x < 0 || goal_x >= (int)mapWidth || goal_z < 0 || goal_index >= graph->NumCells())
 	{
-		bLeft = false;
-		if (i == 0) bLeft = true;
+		return false;
+	}
 
-		for (int offset = height - 1; offset >= 0; offset--)
+	bool bSkip = false;
+	if (!graph->IsNavPoint(goal_index))
+	{
+		if (goal_index + (int)mapWidth < graph->NumCells()) // if goal colliding, find nearest available nav point above (max 1 off)
 		{
-			bSkip = false;
-			path.Empty();
-			path.Add(base);
-
-			for (size_t f = 1; f <= offset; f++) // go up til offset height - 1
-			{
-				index = (z + f) * mapWidth + x;
-
-				for (size_t i = 0; i <= verticalSize; i++)
-				{
-					if (index + i * (int)mapWidth < navMap.Num())
-					{
-						if (navMap[index + i * mapWidth].collision == 0)
-						{
-							bSkip = true;
-							break;
-						}
-					}
-				}
-				
-				if (bSkip) break;
-				
-				path.Add(index);
-			}
-
-			horizontal = 1;
-			index = (z + 1 + offset) * mapWidth + x;
-
-			// if tile above collides then is not valid
-			for (size_t i = 0; i <= verticalSize; i++)
-			{
-				if (index + i * (int)mapWidth < navMap.Num())
-				{
-					if (navMap[index + i * mapWidth].collision == 0)
-					{
-						bSkip = true;
-						break;
-					}
-				}
-			}
-
-			if (!bSkip)
-			{
-				for (size_t j = 1 + offset; j <= height; j++) // go up til jump height
-				{
-					index = (z + j) * mapWidth + x + horizontal * (bLeft ? 1 : -1);
-					if (navMap[index].collision == 0) // if collides then not a valid jump
-					{
-						bSkip = true;
-						break;
-					}
-
-					// or if tile above collides
-					for (size_t i = 0; i <= verticalSize; i++)
-					{
-						if (index + i * (int)mapWidth < navMap.Num())
-						{
-							if (navMap[index + i * mapWidth].collision == 0)
-							{
-								bSkip = true;
-								break;
-							}
-						}
-					}
-
-					path.Add(index);
-
-					if (navMap[index].nav_type != 0)
-					{
-						AddJumpLink(index, base, height, offset, horizontal, path);
-						bSkip = true;
-						break;
-					}
-					
-					horizontal++;
-				}
-			}
-
-			if (!bSkip)
+			if (graph->IsNavPoint(goal_index + mapWidth))
 			{
-				for (size_t j = 1; j <= height; j++) // go back down til level with jump start height
-				{
-					index = (z + height - j) * mapWidth + x + horizontal * (bLeft ? 1 : -1);
-					if (navMap[index].collision == 0)
-					{
-						bSkip = true;
-						break;
-					} // if collides then not a valid jump
-					path.Add(index);
-					
-					if (navMap[index].nav_type != 0) // if row below is a platform, is a valid landing point
-					{
-						AddJumpLink(index, base, height, offset, horizontal, path);
-						bSkip = true;
-						break;
-					}
-
-					if (j < height - offset)
-					{
-						horizontal++;
-					}
-				}
+				goal_z++;
+				bSkip = true;
 			}
+		}
 
-			if (!bSkip)
+		if (!bSkip) // or below
+		{
+			int check = 0;
+			for (int i = goal_z - 1; i > 0; i--)
 			{
-				int check = 0;
-				for (size_t j = 1; j <= maxDropsAfterJump; j++)
+				check = i * mapWidth + goal_x;
+				if (check < graph->NumCells() && check >= 0)
 				{
-					check = (z - j) * mapWidth + x + horizontal  * (bLeft ? 1 : -1);
-					
-					if (check <= 1 || navMap[check].collision == 0) break;
-					path.Add(check);
-					
-					if (navMap[check].nav_type != 0)
+					if (graph->IsNavPoint(check))
 					{
-						// add jump link
-						AddJumpLink(check, base, height + j, offset, horizontal, path);
+						goal_z = i;
 						break;
 					}
 				}
 			}
 		}
 	}
+
+	return true;
 }
 
-void NavSystem::AddJumpLink(int target, int base, int height, int offset, int horizontal, TArray<unsigned int> path)
+// One backward Dijkstra from goal over the reverse links gives every node its distance to the goal and the
+// link to take first, so any number of pawns heading to the same place can read their route off it with
+// FollowFlowField instead of each running a search. The field is tied to this NavSystem's current graph.
+bool NavSystem::BuildFlowField(FVector goal, NavFlowField& field)
 {
-	if (!platformsReached.Contains(target))
+	field.graph = graph;
+	field.goalNode = -1;
+	field.distance.Reset();
+	field.nextEdge.Reset();
+
+	int goal_x, goal_z;
+	if (!graph.IsValid() || !SnapGoal(goal, goal_x, goal_z) || !graph->IsNavPoint(goal_z * mapWidth + goal_x))
 	{
-		platformsReached.Add(target);
-		TSharedRef<JumpInfo> newJump(new JumpInfo());
-		newJump->index = target;
+		return false;
+	}
 
-		int z = 0, highest = 0, z_index = -1;
-		for (size_t i = 0; i < path.Num(); i++)
-		{
-			z = FPlatformMath::FloorToInt(path[i] / mapWidth);
-			if (z > highest)
-			{
-				highest = z;
-				z_index = i;
-			}
-		}
+	const NavGraph& nav = *graph;
+	field.goalNode = nav.GetNode(goal_z * mapWidth + goal_x);
+	field.goal = FVector((goal_x + streamOrigin) * (int)cellSize + (cellSize / 2), 32.0f, (goal_z + 1) * cellSize);
+	field.jumpHeight = jumpHeight;
+	field.pawnHeight = verticalSize;
+	field.distance.Init(MAX_flt, nav.NumNodes());
+	field.nextEdge.Init(-1, nav.NumNodes());
 
-		newJump->bez[0] = -1;
-		newJump->bez[1] = -1;
+	TArray<NavQueueItem>& queue = flowQueue;
+	queue.Reset();
+	field.distance[field.goalNode] = 0.0f;
+	queue.HeapPush({ 0.0f, field.goalNode });
 
-		if (z_index >= 0)
-		{
-			int newZ = highest * mapWidth;
-			newJump->bez[0] = newZ + base % mapWidth;
-			newJump->bez[1] = newZ + target % mapWidth;
-		}
+	while (queue.Num() > 0)
+	{
+		NavQueueItem item;
+		queue.HeapPop(item, false);
+		if (item.cost > field.distance[item.index]) continue; // stale entry, already settled cheaper
 
-		if (path.Num() > 0)
+		unsigned int linkEnd = nav.reverseStart[item.index] + nav.reverseCount[item.index];
+		for (unsigned int r = nav.reverseStart[item.index]; r < linkEnd; r++)
 		{
-			newJump->jump_path = path;
-			navMap[base].jump_paths.Add(path);
-		}
-
-		newJump->jump_cost = FPlatformMath::Sqrt(FPlatformMath::Pow(horizontal, 2.0f) + FPlatformMath::Pow(height, 2.0f));
-		navMap[base].link_jump.Add(*newJump);
+			const NavReverseLink& link = nav.reverseLinks[r];
+			if (!nav.edges[link.edge].Fits(jumpHeight, verticalSize)) continue;
 
-		//UE_LOG(LogTemp, Error, TEXT("add jump from %d to %d (height: %d, offset %d, across %d)"), base, target, height, offset, horizontal * LR);
+			float cost = item.cost + nav.edges[link.edge].cost;
+			if (cost < field.distance[link.source])
+			{
+				field.distance[link.source] = cost;
+				field.nextEdge[link.source] = link.edge;
+				queue.HeapPush({ cost, link.source });
+			}
+		}
 	}
+
+	return true;
 }
 
-void NavSystem::SetStartAndGoal(int start_x, int start_z, int goal_x, int goal_z)
+// Read the route from start to the field's goal into GetPath, in the same form FindPath leaves it
+FVector NavSystem::FollowFlowField(const NavFlowField& field, FVector start)
 {
-	int mapSize = mapWidth * mapHeight;
-	int startIndex = start_z * mapWidth + start_x;
-	int goalIndex = goal_z * mapWidth + goal_x;
+	DeletePath();
 
-	if (start_x >= 0 && start_z >= 0 && goal_x >= 0 && goal_z >= 0
-		&& startIndex < mapSize && goalIndex < mapSize)
+	if (!graph.IsValid() || field.graph != graph || field.goalNode < 0)
 	{
-		startNode = TSharedPtr<PathNode>(new PathNode());
-		startNode->SetCoords(start_x, start_z, startIndex);
-
-		goalNode = TSharedPtr<PathNode>(new PathNode());
-		goalNode->SetCoords(goal_x, goal_z, goalIndex);
+		UE_LOG(LogTemp, Error, TEXT("Flow field wasn't built on this nav graph."));
+		return FVector::ZeroVector;
+	}
 
-		startNode->G = 0.0f; // costs 0 to get to start from start
-		startNode->H = startNode->GetH(goalNode); // estimated cost to get from start to end
-		startNode->parent = 0; // first cell has no parent
+	if (graph->key.bMultiProfile && (field.jumpHeight != jumpHeight || field.pawnHeight != verticalSize))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Flow field was built for jump height %d, pawn height %d."), field.jumpHeight, field.pawnHeight);
+		return FVector::ZeroVector;
+	}
 
-		openList.Add(startNode); // add start cell to end of openList
-		
-		//UE_LOG(LogTemp, Error, TEXT("Set start (%d, %d) and goal (%d, %d)"), start_x, start_z, goal_x, goal_z);
+	int start_x, start_z;
+	if (!SnapStart(start, start_x, start_z) || !graph->IsFree(start_x, start_z))
+	{
+		return FVector::ZeroVector;
 	}
-}
 
-void NavSystem::CheckPath()
-{
-	if (openList.Num() == 0) // if nothing is in openList a path cannot be found
+	int current = graph->IsNavPoint(start_z * mapWidth + start_x) ? graph->GetNode(start_z * mapWidth + start_x) : -1;
+	if (current < 0 || field.distance[current] == MAX_flt)
 	{
 		UE_LOG(LogTemp, Error, TEXT("No path to goal found."));
-		return;
+		return field.goal;
 	}
 
-	int index = 0;
-	float fall = 0.0f;
-	TSharedPtr<PathNode> currentNode = GetNextNode();
+	ResetSearchState();
+	startIndex = current;
+	goalIndex = field.goalNode;
 
-	if (currentNode->index == goalNode->index) // if goal reached
-	{
-		//UE_LOG(LogTemp, Error, TEXT("Goal found!"));
-		
-		// move backwards from goal finding shortest path back to start
-		TSharedPtr<PathNode> getPath;
-		for (getPath = currentNode; getPath.IsValid(); getPath = getPath->parent)
-		{
-			pathNodesToGoal.Add(getPath);
-		}
+	PathNode& startNode = GetSearchNode(current);
+	startNode.G = 0.0f;
+	startNode.parent = -1;
+	startNode.edge = -1;
+	startNode.type = 0;
+	startNode.bez[0] = -1;
+	startNode.bez[1] = -1;
+	startNode.directions.Reset();
 
-		return;
-	}
-	else // if not reached goal
+	while (current != field.goalNode)
 	{
-		//UE_LOG(LogTemp, Error, TEXT("Not reached goal yet"));
+		const NavEdge& edge = graph->edges[field.nextEdge[current]];
+		PathNode& node = GetSearchNode(edge.target);
 
-		TArray<unsigned int> path;
+		node.G = searchNodes[current].G + edge.cost;
+		node.parent = current;
+		node.edge = field.nextEdge[current];
+		SetPathStep(node);
 
-		// run links
-		for (size_t i = 0; i < navMap[currentNode->index].link_run.Num(); i++)
-		{
-			path.Add(currentNode->index);
-			index = navMap[currentNode->index].link_run[i];
+		current = edge.target;
+	}
 
-			if (navMap[index].x_coord > navMap[currentNode->index].x_coord) // if node goes to right
-			{
-				path.Add(currentNode->index + 1);
-			}
-			else if (navMap[index].x_coord < navMap[currentNode->index].x_coord) // else it goes left
-			{
-				path.Add(currentNode->index - 1);
-			}
-			int bezier[2] = { -1, -1 }; // no bezier needed for run
-			AddNodeToOpenList(navMap[index].x_coord, navMap[index].z_coord, currentNode->G + 1.0f, currentNode, path, 1, bezier);
-			path.Empty();
-		}
+	for (int getPath = current; getPath >= 0; getPath = searchNodes[getPath].parent)
+	{
+		pathNodesToGoal.Add(&searchNodes[getPath]);
+	}
 
-		// fall links
-		path.Empty();
-		for (size_t i = 0; i < navMap[currentNode->index].link_fall.Num(); i++)
-		{
-			path.Add(currentNode->index);
-			index = navMap[currentNode->index].link_fall[i];
-			fall = 1.0f;
-			if (navMap[currentNode->index].z_coord > navMap[index].z_coord)
-			{
-				fall = FPlatformMath::Sqrt(1.0f + FPlatformMath::Pow(navMap[currentNode->index].z_coord - navMap[index].z_coord, 2.0f));
-			}
-			
-			int offset = 0;
-			if (navMap[index].x_coord > navMap[currentNode->index].x_coord) // if node goes to right first
-			{
-				offset = 1;
-			}
-			else if (navMap[index].x_coord < navMap[currentNode->index].x_coord) // else it goes left
-			{
-				offset = -1;
-			}
-			path.Add(currentNode->index + offset);
+	return field.goal;
+}
 
-			path.Add(navMap[index].z_coord * mapWidth + navMap[currentNode->index].x_coord + offset);
+// Where a jump on the path goes cell by cell, from the cell it leaves to the landing point. The trajectory
+// comes from the graph's shared pool, so it's only put together for the jumps a pawn asks about.
+void NavSystem::GetJumpPath(const PathNode& node, TArray<unsigned int>& cells) const
+{
+	cells.Reset();
+	if (node.type != 3 || node.edge < 0 || node.parent < 0 || !graph.IsValid())
+	{
+		return;
+	}
 
-			int bezier[2] = { -1, -1 }; // no bezier needed for fall
-			AddNodeToOpenList(navMap[index].x_coord, navMap[index].z_coord, currentNode->G + fall, currentNode, path, 2, bezier);
-			path.Empty();
-		}
+	const NavEdge& edge = graph->edges[node.edge];
+	int fromCell = searchNodes[node.parent].index;
+	for (int i = 0; i < edge.pathLength; i++)
+	{
+		cells.Add(fromCell + graph->jumpPathPool[edge.pathStart + i]);
+	}
+}
 
-		// jump links
-		for (size_t i = 0; i < navMap[currentNode->index].link_jump.Num(); i++)
-		{
-			path.Empty();
-			index = navMap[currentNode->index].link_jump[i].index;
-			path.Add(index);
-			AddNodeToOpenList(navMap[index].x_coord, navMap[index].z_coord, currentNode->G + navMap[currentNode->index].link_jump[i].jump_cost, 
-				currentNode, path, 3, navMap[currentNode->index].link_jump[i].bez);
-		}
+// Cells the pawn passes through taking a link out of fromCell
+void NavSystem::GetLinkDirections(int fromCell, const NavEdge& edge, TArray<unsigned int>& path) const
+{
+	int targetCell = graph->nodeCell[edge.target];
+	int offset = 0;
 
-		for (size_t i = 0; i < openList.Num(); i++) // remove from openList
-		{
-			if (currentNode->index == openList[i]->index)
-			{
-				openList.RemoveAt(i, 1);
-			}
-		}
+	path.Reset();
 
-		CheckPath();
+	switch (edge.kind)
+	{
+	case 1: // run
+		path.Add(fromCell);
+		path.Add(targetCell > fromCell ? fromCell + 1 : fromCell - 1);
+		break;
+
+	case 2: // fall, step off the edge then drop straight down
+		offset = (targetCell % (int)mapWidth > fromCell % (int)mapWidth) ? 1 : -1;
+		path.Add(fromCell);
+		path.Add(fromCell + offset);
+		path.Add((targetCell / mapWidth) * mapWidth + fromCell % mapWidth + offset);
+		break;
+
+	case 3: // jump, the pawn follows the stored trajectory
+		path.Add(targetCell);
+		break;
+
+	default:
+		break;
 	}
 }
 
-TSharedPtr<PathNode> NavSystem::GetNextNode() // finds next available node in openList with the lowest F value
+// Put a path copied out with AppendPath back into the arena, so GetPath reads it as if it had just been searched
+void NavSystem::RestorePath(const NavPathBatch& path)
 {
-	float bestF = 0.0f;
-	int index = 0;
-	TSharedPtr<PathNode> nextNode;
+	const NavPathResult& result = path.results[0];
 
-	for (size_t i = 0; i < openList.Num(); i++)
+	ResetSearchState();
+	if (result.numSteps == 0)
 	{
-		if (openList[i]->GetF() < bestF || i == 0)
-		{
-			bestF = openList[i]->GetF();
-			index = i;
-		}
+		UE_LOG(LogTemp, Error, TEXT("No path to goal found."));
+		return;
 	}
 
-	if (index >= 0)
+	// steps are goal first, so parents come from the step after
+	int parent = -1;
+	for (int i = result.firstStep + result.numSteps - 1; i >= result.firstStep; i--)
 	{
-		nextNode = openList[index];
+		const NavPathStep& step = path.steps[i];
+		int index = graph->GetNode(step.index);
+		PathNode& node = GetSearchNode(index);
+
+		node.G = step.G;
+		node.H = 0.0f;
+		node.parent = parent;
+		node.edge = step.edge;
+		node.type = step.type;
+		node.bez[0] = step.bez[0];
+		node.bez[1] = step.bez[1];
+		node.directions.Reset();
+		for (int d = 0; d < step.numDirections; d++)
+		{
+			node.directions.Add(path.directions[step.firstDirection + d]);
+		}
 
-		// add to visitedList, and remove from openList
-		visitedList.Add(nextNode);
-		openList.RemoveAt(index);
+		if (parent < 0) startIndex = index;
+		parent = index;
 	}
+	goalIndex = parent;
 
-	return nextNode;
+	for (int getPath = goalIndex; getPath >= 0; getPath = searchNodes[getPath].parent)
+	{
+		pathNodesToGoal.Add(&searchNodes[getPath]);
+	}
 }
 
-void NavSystem::AddNodeToOpenList(int x, int z, float newCost, TSharedPtr<PathNode> parent, TArray<unsigned int> path, int type, int bez[2])
+// Run a batch of queries in parallel, typically every pawn's at the end of a turn. All of them have to be on
+// the map this NavSystem's graph was built for, and each jump profile's graph has to be alive already
+// (any pawn still holding it is enough), a request whose graph can't be found just gets no path.
+void NavSystem::FindPaths(const TArray<NavPathRequest>& requests, NavPathBatch& out)
 {
-	// 1 = run
-	// 2 = fall
-	// 3 = jump
+	out.Reset();
 
-	int index = z * mapWidth + x;
-
-	// check this cell id against visited list to make sure it's not already been checked
-	for (size_t i = 0; i < visitedList.Num(); i++)
+	if (!graph.IsValid())
 	{
-		if (index == visitedList[i]->index)
-		{
-			return;
-		}
+		return;
 	}
 
-	// create new path search node
-	TSharedPtr<PathNode> newChild = TSharedPtr<PathNode>(new PathNode());
-	newChild->SetCoords(x, z, index);
-	newChild->parent = parent;
-	newChild->G = newCost;
-	newChild->H = parent->GetH(goalNode);
-	newChild->directions = path;
-	newChild->type = type;
-	newChild->bez[0] = bez[0];
-	newChild->bez[1] = bez[1];
-
-	for (size_t i = 0; i < openList.Num(); i++)
+	// look the graphs up front so the workers never touch the cache lock
+	batchGraphs.SetNum(requests.Num());
+	for (int i = 0; i < requests.Num(); i++)
 	{
-		if (index == openList[i]->index)
+		NavGraphKey key = graph->key;
+		key.jumpHeight = requests[i].jumpHeight;
+		key.pawnHeight = requests[i].pawnHeight;
+		if (graph->key.bMultiProfile)
 		{
-			float newF = newChild->G + openList[i]->H;
+			// one graph for everybody within the profiles it was built for
+			bool bFits = key.jumpHeight <= graph->key.jumpHeight && key.pawnHeight <= graph->key.pawnHeight;
+			batchGraphs[i] = bFits ? graph : NavGraphPtr();
+		}
+		else
+		{
+			batchGraphs[i] = key == graph->key ? graph : NavGraphCache::Find(key);
+		}
 
-			if (newF < openList[i]->GetF()) // if new F is smaller than current F, replace it
-			{
-				openList[i]->G = newChild->G;
-				openList[i]->parent = parent;
-				openList[i]->directions = newChild->directions;
-				openList[i]->type = newChild->type;
-				openList[i]->bez[0] = newChild->bez[0];
-				openList[i]->bez[1] = newChild->bez[1];
-				openList[i]->SetCoords(newChild->x_coord, newChild->z_coord, newChild->index);
-			}
-			else return; // if new F is not smaller, ignore it
+		if (!batchGraphs[i].IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("No nav graph built for jump height %d, pawn height %d."), key.jumpHeight, key.pawnHeight);
 		}
 	}
 
-	openList.Add(newChild);
-}
-
-FVector NavSystem::FindPath(FVector start, FVector goal)
-{
-	// Remove old
-	DeletePath();
-
-	// Initialize start
-	int start_x = FPlatformMath::FloorToInt(start.X / cellSize);
-	int start_z = FPlatformMath::FloorToInt(start.Z / cellSize) - 1;
-	int start_index = start_z * mapWidth + start_x;
-
-	// Initialize goal
-	int goal_x = FPlatformMath::FloorToInt(goal.X / cellSize);
-	int goal_z = FPlatformMath::FloorToInt(goal.Z / cellSize);
-	int goal_index = goal_z * mapWidth + goal_x;
-
-	int mapSize = mapWidth * mapHeight;
+	// contiguous blocks, one worker each, so the joined output is in request order
+	int blockCount = FPlatformMath::Min(requests.Num(), FPlatformMath::Max(1, FPlatformMisc::NumberOfCores()));
+	int blockSize = blockCount > 0 ? (requests.Num() + blockCount - 1) / blockCount : 0;
 
-	if (start_z < 0 || goal_z < 0 || start_index >= navMap.Num() || goal_index >= navMap.Num())
+	while (batchWorkers.Num() < blockCount)
 	{
-		return FVector::ZeroVector;
+		batchWorkers.Add(MakeShared<NavSystem>());
 	}
+	batchBlocks.SetNum(blockCount);
 
-	if (navMap[start_index].nav_type == 0) // if start colliding, find nearest available nav point above (max 1 off)
+	ParallelFor(blockCount, [&](int32 block)
 	{
-		if (start_index + (int)mapWidth < navMap.Num())
+		NavSystem& worker = *batchWorkers[block];
+		NavPathBatch& blockOut = batchBlocks[block];
+		blockOut.Reset();
+
+		worker.mapWidth = mapWidth;
+		worker.mapHeight = mapHeight;
+		worker.cellSize = cellSize;
+		worker.streamOrigin = streamOrigin;
+		worker.query = query;
+		worker.searchPolicy = searchPolicy;
+
+		int last = FPlatformMath::Min((block + 1) * blockSize, requests.Num());
+		for (int i = block * blockSize; i < last; i++)
 		{
-			if (navMap[start_index + mapWidth].nav_type != 0)
-			{
-				start_z++;
-				start_index += mapWidth;
-			}
+			worker.graph = batchGraphs[i];
+			worker.jumpHeight = requests[i].jumpHeight;
+			worker.verticalSize = requests[i].pawnHeight;
+			FVector goal = worker.FindPath(requests[i].start, requests[i].goal);
+			worker.AppendPath(goal, blockOut);
 		}
-	}
 
-	bool bSkip = false;
-	if (navMap[goal_index].nav_type == 0)
+		worker.graph.Reset(); // don't keep a graph alive on the pawns' behalf
+	}, !bParallelBatch);
+
+	// join the blocks, shifting their offsets along
+	for (int block = 0; block < blockCount; block++)
 	{
-		if (goal_index + (int)mapWidth < navMap.Num()) // if goal colliding, find nearest available nav point above (max 1 off)
+		const NavPathBatch& blockOut = batchBlocks[block];
+		int stepBase = out.steps.Num();
+		int directionBase = out.directions.Num();
+
+		for (int i = 0; i < blockOut.results.Num(); i++)
 		{
-			if (navMap[goal_index + mapWidth].nav_type != 0)
-			{
-				goal_z++;
-				goal_index += mapWidth;
-				bSkip = true;
-			}
+			NavPathResult result = blockOut.results[i];
+			result.firstStep += stepBase;
+			out.results.Add(result);
 		}
 
-		if (!bSkip) // or below
+		for (int i = 0; i < blockOut.steps.Num(); i++)
 		{
-			int check = 0;
-			for (int i = goal_z - 1; i > 0; i--)
-			{
-				check = i * mapWidth + goal_x;
-				if (check < navMap.Num() && check >= 0)
-				{
-					if (navMap[check].nav_type != 0)
-					{
-						goal_z = i;
-						goal_index = check;
-						break;
-					}
-				}
-			}
+			NavPathStep step = blockOut.steps[i];
+			step.firstDirection += directionBase;
+			out.steps.Add(step);
 		}
+
+		out.directions.Append(blockOut.directions);
 	}
 
-	// If start or goal is colliding then can't return the location
-	if (navMap[start_z * mapWidth + start_x].collision == 0 || navMap[goal_z * mapWidth + goal_x].collision == 0)
+	for (int i = 0; i < batchGraphs.Num(); i++)
 	{
-		return FVector::ZeroVector;
+		batchGraphs[i].Reset();
 	}
-	
-	SetStartAndGoal(start_x, start_z, goal_x, goal_z); // initialise start and goal points
-	CheckPath(); // begin pathfinding
-	return FVector(goal_x * cellSize + (cellSize / 2), 32.0f, (goal_z + 1) * cellSize); // return world location for start and goal
+}
+
+// Copy the last FindPath result onto the end of a batch
+void NavSystem::AppendPath(FVector goal, NavPathBatch& out) const
+{
+	NavPathResult result;
+	result.goal = goal;
+	result.cost = pathNodesToGoal.Num() > 0 ? pathNodesToGoal[0]->G : -1.0f;
+	result.firstStep = out.steps.Num();
+	result.numSteps = pathNodesToGoal.Num();
+
+	for (int i = 0; i < pathNodesToGoal.Num(); i++)
+	{
+		const PathNode& node = *pathNodesToGoal[i];
+		NavPathStep step;
+		step.x_coord = node.x_coord;
+		step.z_coord = node.z_coord;
+		step.index = node.index;
+		step.type = node.type;
+		step.bez[0] = node.bez[0];
+		step.bez[1] = node.bez[1];
+		step.edge = node.edge;
+		step.G = node.G;
+		step.firstDirection = out.directions.Num();
+		step.numDirections = node.directions.Num();
+		out.directions.Append(node.directions);
+		out.steps.Add(step);
+	}
+
+	out.results.Add(result);
 }
 
 void NavSystem::DeleteAll()
 {
 	DeleteNav();
 	DeletePath();
+
+	// the arena is sized to the map, so free it along with the nav data
+	batchWorkers.Empty();
+	batchBlocks.Empty();
+	searchNodes.Empty();
+	openList.Empty();
+	pathNodesToGoal.Empty();
 }
 
 void NavSystem::DeleteNav()
 {
 	navMap.Empty();
+	graph.Reset();
+
+	// streaming ends with the graph it was feeding
+	streamStripWidth = 0;
+	streamOrigin = 0;
+	streamAttached.Empty();
 }
 
+// Forget the last query, keeping the arena and list allocations for the next one
 void NavSystem::DeletePath()
 {
-	startNode.Reset();
-	goalNode.Reset();
-	openList.Empty();
-	visitedList.Empty();
-	pathNodesToGoal.Empty();
+	pathStatus = ENavPathStatus::Idle;
+	startIndex = -1;
+	goalIndex = -1;
+	bCorridorSearch = false;
+	corridorState = 0;
+	searchLoop = 0;
+	bBidirectionalSearch = false;
+	bLandmarkSearch = false;
+	openList.Reset();
+	pathNodesToGoal.Reset();
 }
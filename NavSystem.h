@@ -6,28 +6,18 @@ struct PathNode
 {
 	int x_coord, z_coord, index, type;
 	int bez[2];
-	TSharedPtr<PathNode> parent;
+	int parent; // node id of the node this one was reached from, -1 for the start
+	int edge; // graph edge it was reached by, -1 for the start and run shortcuts
 	float G; // cumulative distance
 	float H; // heuristic (estimated) distance to goal
-	TArray<unsigned int> directions;
-
-	float GetF() { return G + H; } // F = G + H
+	TArray<unsigned int> directions; // type, bez and directions are only filled in for nodes on the found path
 
-	float GetH(TSharedPtr<PathNode> goal) // distance from current cell to target cell
-	{
-		// Manhattan (least accurate)
-		//float x = FPlatformMath::Abs((float)(this->x_coord - goal->x_coord));
-		//float z = FPlatformMath::Abs((float)(this->z_coord - goal->z_coord));
-		//return x + z;
+	// search bookkeeping, only meaningful while searchId matches NavSystem::searchId
+	unsigned int searchId;
+	int heapIndex; // position in openList, -1 if not in it
+	uint8 state; // 0 = unvisited, 1 = open, 2 = closed
 
-		// Pythagorean
-		float x = FPlatformMath::Pow(this->x_coord - goal->x_coord, 2.0f);
-		float z = FPlatformMath::Pow(this->z_coord - goal->z_coord, 2.0f);
-		return FPlatformMath::Sqrt(x + z);
-
-		// Just use F (most accurate but slowest)
-		//return 0;
-	}
+	float GetF() const { return G + H; } // F = G + H
 
 	void SetCoords(int x, int z, int id)
 	{
@@ -38,6 +28,11 @@ struct PathNode
 
 	PathNode()
 	{
+		parent = -1;
+		edge = -1;
+		searchId = 0;
+		heapIndex = -1;
+		state = 0;
 	}
 };
 
@@ -46,36 +41,730 @@ struct JumpInfo
 	unsigned int index;
 	int bez[2];
 	float jump_cost;
-	TArray<unsigned int> jump_path;
+	unsigned int pathStart; // trajectory in JumpStencilTable::paths, see NavEdge
+	uint16 pathLength;
+	uint8 jumpHeight; // see NavEdge
+	uint8 minPawnHeight;
+	uint8 maxPawnHeight;
 
 	JumpInfo()
 	{
 	}
 };
 
+// Links out of one nav point while the graph is being built, its cell and nav_type are in NavGraph already
 struct NavPoint
 {
-	unsigned int x_coord, z_coord, nav_type, collision;
-	TArray<unsigned int> link_run;
+	TArray<unsigned int> link_run; // target cells
 	TArray<unsigned int> link_fall;
 	TArray<JumpInfo> link_jump;
-	TArray<TArray<unsigned int>> jump_paths;
+};
+
+// One link in the finalized graph
+struct NavEdge
+{
+	unsigned int target; // node id
+	float cost;
+	int bez[2]; // jump bezier control cells, -1 if not a jump
+	unsigned int pathStart; // offset of the jump trajectory in NavGraph::jumpPathPool, shared by every jump along the same arc
+	uint16 pathLength; // 0 if not a jump, otherwise the start cell and the cells up to the landing point
+	uint8 kind; // 1 = run, 2 = fall, 3 = jump
+	uint8 jumpHeight; // lowest jump height that makes the link, 0 for runs and falls
+	uint8 minPawnHeight; // pawn heights it's for, a jump is only the one a pawn takes if the arcs before it
+	uint8 maxPawnHeight; // didn't fit it, so on a multi-profile graph shorter pawns can have their own
+
+	bool Fits(int pawnJumpHeight, int pawnHeight) const
+	{
+		return jumpHeight <= pawnJumpHeight && minPawnHeight <= pawnHeight && pawnHeight <= maxPawnHeight;
+	}
+};
+
+// Per-thread working state for jump link generation
+struct JumpBuildScratch
+{
+	TArray<unsigned int> platformsReached; // landing cells already linked from the current base
+	TArray<uint8> reachedHeights; // per platformsReached entry, tallest pawn already linked there
+};
+
+// One cell of a precompiled jump arc, relative to the nav point the jump starts from
+struct JumpStencilStep
+{
+	int dcell; // dz * mapWidth + dx
+	int16 dx, dz;
+	int16 topDz; // highest trajectory row so far, for the bezier control points
+	uint8 flags; // JUMPSTEP_ bits
+	uint16 pathLength; // cells of the arc's trajectory up to here, the start cell included
+	float cost; // jump_cost if the arc lands here
+};
+
+#define JUMPSTEP_CLEARANCE 1 // the pawn's full height has to fit, not just its feet
+#define JUMPSTEP_PATH 2 // part of the trajectory handed to the pawn
+#define JUMPSTEP_LAND 4 // the arc ends here if this is a nav point
+
+struct JumpStencil
+{
+	int firstStep;
+	int numSteps;
+	int pathStart; // into JumpStencilTable::paths
+	int height; // jump height it needs
+};
+
+// Every jump arc for one jump profile and map width, in the order they're tried
+struct JumpStencilTable
+{
+	int jumpHeight = -1;
+	int verticalSize = -1;
+	int maxDropsAfterJump = -1;
+	unsigned int mapWidth = 0;
+	int reachX = 0; // furthest any arc goes across
+	int minDz = 0; // lowest and highest rows any arc touches
+	int maxDz = 0;
+	TArray<JumpStencilStep> steps;
+	TArray<JumpStencil> arcs;
+	TArray<int> paths; // each arc's whole trajectory as offsets from the start cell, a jump landing partway uses the front of it
+};
+
+// Everything a built graph depends on
+struct NavGraphKey
+{
+	uint32 mapVersion;
+	unsigned int mapWidth, mapHeight;
+	int jumpHeight, pawnHeight;
+	int numLandmarks; // built in, so graphs with and without them aren't interchangeable
+	int chunkSize; // hierarchy chunk size asked for, 0 = none
+	int maxReachComponents; // past this many components the graph has no reachability bitmaps
+	bool bMultiProfile; // links for every jump height and pawn height up to jumpHeight and pawnHeight, see NavEdge::Fits
+
+	bool operator==(const NavGraphKey& other) const
+	{
+		return mapVersion == other.mapVersion && mapWidth == other.mapWidth && mapHeight == other.mapHeight
+			&& jumpHeight == other.jumpHeight && pawnHeight == other.pawnHeight && numLandmarks == other.numLandmarks
+			&& chunkSize == other.chunkSize && maxReachComponents == other.maxReachComponents && bMultiProfile == other.bMultiProfile;
+	}
+
+	friend uint32 GetTypeHash(const NavGraphKey& key)
+	{
+		uint32 hash = HashCombine(key.mapVersion, GetTypeHash(key.mapWidth));
+		hash = HashCombine(hash, GetTypeHash(key.mapHeight));
+		hash = HashCombine(hash, GetTypeHash(key.jumpHeight));
+		hash = HashCombine(hash, GetTypeHash(key.pawnHeight));
+		hash = HashCombine(hash, GetTypeHash(key.numLandmarks));
+		hash = HashCombine(hash, GetTypeHash(key.chunkSize));
+		hash = HashCombine(hash, GetTypeHash(key.maxReachComponents));
+		return HashCombine(hash, GetTypeHash(key.bMultiProfile));
+	}
+};
+
+// Chunk layer over the graph for long queries. The map is cut into chunkSize x chunkSize squares,
+// a node with a link into or out of another chunk is one of its chunk's entrances, and every chunk
+// keeps the cheapest route that stays inside it from each entrance to the others. Routes that pass
+// through a third entrance are left out, they're covered by chaining the two shorter ones.
+struct NavChunkLink
+{
+	int target; // node id
+	float cost;
+};
+
+struct NavChunk
+{
+	TArray<int> entrances; // node ids
+	TArray<unsigned int> linkStart; // per entrance plus one, links of entrance i are links[linkStart[i] .. linkStart[i + 1])
+	TArray<NavChunkLink> links;
+};
+
+struct NavHierarchy
+{
+	int chunkSize = 0; // 0 = not built
+	int chunksX = 0;
+	int chunksZ = 0;
+	TArray<NavChunk> chunks;
+	TArray<int> entranceSlot; // per node, index into its chunk's entrances or -1
+	TArray<uint16> crossIn; // per node, links arriving from other chunks
+
+	bool IsBuilt() const { return chunkSize > 0; }
+};
+
+// Entry in the lazy-deletion heaps of the Dijkstra searches
+struct NavQueueItem
+{
+	float cost;
+	int index; // node id, or local index within a chunk
+
+	bool operator<(const NavQueueItem& other) const { return cost < other.cost; }
+};
+
+// Dijkstra confined to one chunk, used to fill in entrance costs and to hook a query's start and goal onto the entrances
+struct ChunkSearchScratch
+{
+	int x0 = 0, z0 = 0, x1 = 0, z1 = 0; // chunk cell rect, exclusive at the top end
+	TArray<int> nodes; // node ids inside the chunk
+	TArray<int> localIndex; // per chunk cell, index into nodes or -1
+	TArray<float> dist; // per local node, from the source (or to it when searching backwards)
+	TArray<uint8> viaEntrance; // per local node, 1 if its cheapest route passes another entrance on the way
+	TArray<unsigned int> linkStart; // per local node plus one, the links inside the chunk out of it (into it when searching backwards)
+	TArray<int> linkNode; // local index of the other end
+	TArray<float> linkCost;
+	TArray<NavQueueItem> queue;
+
+	int GetLocal(unsigned int cell, unsigned int mapWidth) const
+	{
+		int x = cell % mapWidth;
+		int z = cell / mapWidth;
+		if (x < x0 || x >= x1 || z < z0 || z >= z1) return -1;
+		return localIndex[(z - z0) * (x1 - x0) + (x - x0)];
+	}
+};
+
+// Arena record for bidirectional searches. Side 0 searches forward from the start, side 1 backward from the goal.
+struct BidirectionalNode
+{
+	float G[2];
+	int parent[2]; // previous node on side 0, next node towards the goal on side 1
+	int edge[2]; // index into NavGraph::edges of the link between them
+	float potential; // half of (distance to goal - distance to start), both sides order their queues by G +- this
+	unsigned int searchId;
+	uint8 state[2]; // 0 = unvisited, 1 = open, 2 = closed
+};
+
+// A link seen from its target end
+struct NavReverseLink
+{
+	int source; // node id
+	unsigned int edge; // index into NavGraph::edges
+};
+
+// Which nodes can get to which, for turning unreachable queries down without a search
+struct NavComponents
+{
+	int numComponents = 0; // strongly connected components, numbered so that links only go to the same or a lower one
+	TArray<int> nodeComponent; // per node, -1 if the id is free
+	int reachWords = 0; // uint64s per component in reachBits, 0 if there were too many components to keep them
+	TArray<uint64> reachBits; // per component, bit c set if component c can be reached from it
+};
+
+// ALT landmarks and every node's distances to and from them, see NavSystem::BuildLandmarks
+struct NavLandmarks
+{
+	int count = 0; // 0 = straight line heuristic only
+	TArray<int> nodes; // node ids
+	TArray<float> from; // per node, count distances from each landmark, MAX_flt if it can't get there
+	TArray<float> to; // per node, count distances to each landmark
+};
+
+// A lock that belongs to one graph. A copy of the graph gets a lock of its own.
+class NavGraphLock : public FCriticalSection
+{
+public:
+	NavGraphLock() {}
+	NavGraphLock(const NavGraphLock&) {}
+	NavGraphLock& operator=(const NavGraphLock&) { return *this; }
+};
+
+// Compressed sparse row navigation graph, built once by BuildNavigation and read by the search.
+// Only standable cells get a node id, and the links of node n are edges[edgeStart[n] .. edgeStart[n] + edgeCount[n]).
+// UpdateRegion appends replacement links and recycles the ids of nodes it removes, so ranges and ids can have gaps.
+struct NavGraph
+{
+	NavGraphKey key; // also holds the map size and jump profile it was built for
+	int maxDropsAfterJump = 0;
+
+	int rowWords = 0; // uint64s per row in the bitmaps
+	TArray<uint64> freeBits; // bit x of row z set if the cell is free
+	TArray<uint64> clearBits; // bit x of row z set if the pawn's whole height fits there
+	TArray<int> cellToNode; // per cell, node id or -1
+	TArray<unsigned int> nodeCell; // per node, cell index, MAX_uint32 if the id is free
+	TArray<uint8> nodeType; // per node, nav_type from DetectPlatforms
+	TArray<unsigned int> edgeStart; // per node
+	TArray<unsigned int> edgeCount; // per node
+	TArray<NavEdge> edges;
+	TArray<int> jumpPathPool; // the jump profile's arc trajectories relative to the start cell, a copy of JumpStencilTable::paths
+	TArray<int> freeNodes; // ids UpdateRegion can hand out again
+	int deadEdges = 0; // edges no node points at any more
+	TArray<unsigned int> reverseStart; // per node, its incoming links are reverseLinks[reverseStart[n] .. + reverseCount[n])
+	TArray<unsigned int> reverseCount;
+	TArray<NavReverseLink> reverseLinks;
+	int deadReverseLinks = 0;
+	NavHierarchy hierarchy;
+	TArray<int> runSkip; // per node [left, right], nearest stop along the platform each way or -1
+	mutable NavLandmarks landmarks; // redone in place on a shared graph, see NavSystem::UpdateLandmarks
+	mutable volatile int64 landmarksStale = 0; // 1 once UpdateRegion has changed links, the search goes without them until they're redone
+	mutable NavComponents components; // redone in place on a shared graph, see NavSystem::UpdateComponents
+	mutable volatile int64 componentsStale = 0; // 1 once UpdateRegion has changed links, the first query after redoes them
+	mutable NavGraphLock rebuildLock; // held while the components or landmarks are redone, or the graph is copied
+
+	int NumNodes() const { return nodeCell.Num(); }
+	int NumCells() const { return cellToNode.Num(); }
+	int GetNode(int cell) const { return cellToNode[cell]; }
+	bool IsNavPoint(int cell) const { return cellToNode[cell] >= 0; }
+
+	int GetChunk(int node) const
+	{
+		unsigned int cell = nodeCell[node];
+		return (cell / key.mapWidth / hierarchy.chunkSize) * hierarchy.chunksX + (cell % key.mapWidth) / hierarchy.chunkSize;
+	}
+
+	// anything outside the map is solid
+	bool IsFree(int x, int z) const
+	{
+		return x >= 0 && z >= 0 && x < (int)key.mapWidth && z < (int)key.mapHeight
+			&& ((freeBits[z * rowWords + (x >> 6)] >> (x & 63)) & 1);
+	}
+
+	bool HasClearance(int x, int z) const
+	{
+		return x >= 0 && z >= 0 && x < (int)key.mapWidth && z < (int)key.mapHeight
+			&& ((clearBits[z * rowWords + (x >> 6)] >> (x & 63)) & 1);
+	}
+
+	void SetFree(int x, int z, bool bFree)
+	{
+		uint64 mask = (uint64)1 << (x & 63);
+		uint64& word = freeBits[z * rowWords + (x >> 6)];
+		word = bFree ? (word | mask) : (word & ~mask);
+	}
+
+	void UpdateClearance(int firstRow, int lastRow);
+
+	// free cells above a free one, at most key.pawnHeight, which is also what a cell near the top of the map gets
+	int GetHeadroom(int x, int z) const
+	{
+		for (int h = 1; h <= key.pawnHeight; h++)
+		{
+			if (z + h < (int)key.mapHeight && !IsFree(x, z + h)) return h - 1;
+		}
+		return key.pawnHeight;
+	}
+
+	// free with solid ground below
+	bool IsStandable(int x, int z) const { return z > 0 && IsFree(x, z) && !IsFree(x, z - 1); }
+
+	bool HasLandmarks() const { return landmarks.count > 0 && !FPlatformAtomics::AtomicRead(&landmarksStale); }
+
+	// false if no route leads from one node to the other. Without reachBits, with the components stale, or on a
+	// multi-profile graph where the components are over every pawn's links, true only means there might be one.
+	bool MightReach(int from, int to) const
+	{
+		if (FPlatformAtomics::AtomicRead(&componentsStale) || components.numComponents == 0) return true;
+
+		int a = components.nodeComponent[from];
+		int b = components.nodeComponent[to];
+		if (a == b) return true;
+		if (a < b) return false;
+		int words = components.reachWords;
+		return words == 0 || ((components.reachBits[a * words + (b >> 6)] >> (b & 63)) & 1);
+	}
+};
+
+typedef TSharedPtr<const NavGraph, ESPMode::ThreadSafe> NavGraphPtr;
+
+// Process-wide registry of built graphs, so pawns with the same jump profile share one read-only graph.
+// Only weak references are held, a graph is freed once the last NavSystem using it lets go.
+class NavGraphCache
+{
+public:
+	static NavGraphPtr Find(const NavGraphKey& key);
+	static NavGraphPtr Register(const NavGraphKey& key, NavGraphPtr graph); // returns the graph to use, which may be one registered first by another thread
+	static void Remove(const NavGraphKey& key);
+	static bool TakeIfUnique(const NavGraphPtr& graph); // unregisters it if the caller holds the only reference, for patching in place
+	static void Empty();
+
+private:
+	static FCriticalSection lock;
+	static TMap<NavGraphKey, TWeakPtr<const NavGraph, ESPMode::ThreadSafe>> graphs;
+};
+
+// Binary graph file written by NavSystem::SaveNavigation, meant to be cooked offline and read at level load.
+// A header, then each array of the graph as raw data at the offset its section entry gives, 8 byte aligned.
+#define NAVFILE_MAGIC 0x4756414E // "NAVG"
+#define NAVFILE_VERSION 6
+
+enum NavFileSectionId
+{
+	NAVSECTION_FREEBITS,
+	NAVSECTION_CLEARBITS,
+	NAVSECTION_CELLTONODE,
+	NAVSECTION_NODECELL,
+	NAVSECTION_NODETYPE,
+	NAVSECTION_EDGESTART,
+	NAVSECTION_EDGECOUNT,
+	NAVSECTION_EDGES,
+	NAVSECTION_JUMPPATHPOOL,
+	NAVSECTION_FREENODES,
+	NAVSECTION_REVERSESTART,
+	NAVSECTION_REVERSECOUNT,
+	NAVSECTION_REVERSELINKS,
+	NAVSECTION_RUNSKIP,
+	NAVSECTION_ENTRANCESLOT,
+	NAVSECTION_CROSSIN,
+	NAVSECTION_CHUNKENTRANCESTART, // per chunk plus one, into CHUNKENTRANCES
+	NAVSECTION_CHUNKENTRANCES,
+	NAVSECTION_CHUNKLINKSTART, // every chunk's linkStart back to back, chunk c's begins at CHUNKENTRANCESTART[c] + c
+	NAVSECTION_CHUNKLINKOFFSET, // per chunk plus one, into CHUNKLINKS
+	NAVSECTION_CHUNKLINKS,
+	NAVSECTION_LANDMARKS,
+	NAVSECTION_LANDMARKFROM,
+	NAVSECTION_LANDMARKTO,
+	NAVSECTION_NODECOMPONENT,
+	NAVSECTION_REACHBITS,
+	NAVSECTION_COUNT
+};
+
+struct NavFileSection
+{
+	uint64 offset; // from the start of the file
+	uint32 count;
+	uint32 elementSize; // checked on load, so a file from a build with a different layout is refused
+};
+
+struct NavFileHeader
+{
+	uint32 magic;
+	uint32 version;
+	NavGraphKey key; // map size, jump profile and version of the map it was built from
+	uint32 collisionCrc; // of the free cell bitmap
+	int maxDropsAfterJump;
+	int rowWords;
+	int deadEdges;
+	int deadReverseLinks;
+	int chunkSize; // hierarchy, 0 if it wasn't built
+	int chunksX;
+	int chunksZ;
+	int numLandmarks;
+	int numComponents;
+	int reachWords;
+	NavFileSection sections[NAVSECTION_COUNT];
+};
+
+// Distance to one goal from every node and the first link to take, see NavSystem::BuildFlowField
+struct NavFlowField
+{
+	NavGraphPtr graph; // graph it was built on, it goes stale once that graph is updated
+	int goalNode = -1;
+	FVector goal; // snapped goal location, what FindPath would have returned
+	int jumpHeight; // pawn profile it was built for, only pawns with the same one can follow it on a multi-profile graph
+	int pawnHeight;
+	TArray<float> distance; // per node, MAX_flt if the goal can't be reached
+	TArray<int> nextEdge; // per node, index into graph->edges, -1 at the goal or if unreachable
+};
+
+// One pawn's query for NavSystem::FindPaths
+struct NavPathRequest
+{
+	FVector start;
+	FVector goal;
+	int jumpHeight;
+	int pawnHeight;
+};
+
+// A request's answer and where its path sits in the batch buffers
+struct NavPathResult
+{
+	FVector goal; // what FindPath would have returned
+	float cost; // -1 if there's no path
+	int firstStep; // into NavPathBatch::steps, goal first like GetPath
+	int numSteps;
+};
+
+// PathNode without the search bookkeeping, directions live in NavPathBatch::directions
+struct NavPathStep
+{
+	int x_coord, z_coord, index, type;
+	int bez[2];
+	int edge;
+	float G; // cost from the start
+	int firstDirection;
+	int numDirections;
+};
+
+// Output of FindPaths, results[i] answers requests[i]
+struct NavPathBatch
+{
+	TArray<NavPathResult> results;
+	TArray<NavPathStep> steps;
+	TArray<unsigned int> directions;
+
+	void Reset()
+	{
+		results.Reset();
+		steps.Reset();
+		directions.Reset();
+	}
+};
+
+// A query as the path cache sees it, after snapping
+struct NavPathKey
+{
+	NavGraphKey graph; // map version and jump profile, so edits and rebuilds of the map never hit old paths
+	int startCell;
+	int goalCell;
+	uint32 policy; // search policy id, another heuristic or cost model can find another path
+	int jumpHeight; // the pawn's own, a multi-profile graph is shared by pawns with different ones
+	int pawnHeight;
 
-	NavPoint()
+	bool operator==(const NavPathKey& other) const
 	{
-		collision = 1;
+		return graph == other.graph && startCell == other.startCell && goalCell == other.goalCell && policy == other.policy
+			&& jumpHeight == other.jumpHeight && pawnHeight == other.pawnHeight;
 	}
+
+	friend uint32 GetTypeHash(const NavPathKey& key)
+	{
+		uint32 hash = HashCombine(GetTypeHash(key.graph), GetTypeHash(key.startCell));
+		hash = HashCombine(hash, GetTypeHash(key.goalCell));
+		hash = HashCombine(hash, GetTypeHash(key.policy));
+		hash = HashCombine(hash, GetTypeHash(key.jumpHeight));
+		return HashCombine(hash, GetTypeHash(key.pawnHeight));
+	}
+};
+
+// Process-wide least recently used cache of finished searches, shared by every pawn.
+// Failed searches are kept too, they're usually the most expensive ones to repeat.
+class NavPathCache
+{
+public:
+	static bool Find(const NavPathKey& key, NavPathBatch& path); // path gets a copy of the entry, one result
+	static void Add(const NavPathKey& key, const NavPathBatch& path);
+	static void SetCapacity(int maxPaths); // 0 turns caching off
+	static void GetStats(uint64& hits, uint64& misses);
+	static void ResetStats();
+	static void Empty();
+	static uint32 NewPolicyId(); // one per search policy type, see NavSystem::SetSearchPolicy
+
+private:
+	struct Entry
+	{
+		NavPathKey key;
+		NavPathBatch path;
+		int prev; // towards more recently used, -1 at the head
+		int next;
+	};
+
+	static void Unlink(int slot);
+	static void LinkAtHead(int slot);
+
+	static FCriticalSection lock;
+	static TMap<NavPathKey, int> slots;
+	static TArray<Entry> entries;
+	static int head;
+	static int tail;
+	static int capacity;
+	static uint64 hits;
+	static uint64 misses;
+	static uint32 nextPolicyId;
+};
+
+// Where a time sliced query (NavSystem::BeginPath) has got to
+enum class ENavPathStatus : uint8
+{
+	Idle, // nothing begun, or cancelled
+	InProgress,
+	Found,
+	Failed
+};
+
+// Search policies. A policy fixes the heuristic, what each link costs and which kinds of link the pawn takes at
+// compile time, and each one gets its own copy of the search loop (NavSystem::ExpandPathT) with none of that
+// decided per node. NavSystem::SetSearchPolicy switches a pawn over, FindPath<Policy> uses one for a single query.
+
+// Straight line distance, raised by the ALT landmarks if the graph has them. Never overestimates, so paths are
+// the cheapest there are.
+struct NavEuclideanHeuristic
+{
+	static constexpr bool bUseLandmarks = true;
+	static constexpr bool bBidirectional = true; // the potentials of ExpandBidirectional are this same estimate
+
+	static float Estimate(int dx, int dz) { return FPlatformMath::Sqrt((float)(dx * dx + dz * dz)); }
+};
+
+// Overestimates anything but a straight run or drop, so fewer nodes get expanded but the path can cost more
+struct NavManhattanHeuristic
+{
+	static constexpr bool bUseLandmarks = false;
+	static constexpr bool bBidirectional = false;
+
+	static float Estimate(int dx, int dz) { return (float)(FPlatformMath::Abs(dx) + FPlatformMath::Abs(dz)); }
+};
+
+// No estimate at all, which makes the search Dijkstra's
+struct NavZeroHeuristic
+{
+	static constexpr bool bUseLandmarks = false;
+	static constexpr bool bBidirectional = false;
+
+	static float Estimate(int /*dx*/, int /*dz*/) { return 0.0f; }
+};
+
+// Link costs as BuildNavigation worked them out: 1 per cell for runs, the length of the drop or the arc otherwise
+struct NavGraphCosts
+{
+	static constexpr bool bGraphCosts = true;
+
+	static float Cost(const NavEdge& edge) { return edge.cost; }
+};
+
+// Built costs scaled per kind of link, in percent, e.g. TNavWeightedCosts<100, 100, 300> for a pawn that only
+// jumps when there's no other way. Under 100 the heuristic can overestimate and paths may not be the cheapest.
+template <int RunPercent, int FallPercent, int JumpPercent>
+struct TNavWeightedCosts
+{
+	static constexpr bool bGraphCosts = RunPercent == 100 && FallPercent == 100 && JumpPercent == 100;
+
+	static float Cost(const NavEdge& edge)
+	{
+		static constexpr float weights[4] = { 0.0f, RunPercent * 0.01f, FallPercent * 0.01f, JumpPercent * 0.01f };
+		return edge.cost * weights[edge.kind];
+	}
+};
+
+#define NAVLINK_RUN 0x2 // 1 << NavEdge::kind
+#define NAVLINK_FALL 0x4
+#define NAVLINK_JUMP 0x8
+#define NAVLINK_ALL (NAVLINK_RUN | NAVLINK_FALL | NAVLINK_JUMP)
+
+template <typename HeuristicType, typename CostType = NavGraphCosts, uint8 LinkKinds = NAVLINK_ALL>
+struct TNavSearchPolicy
+{
+	typedef HeuristicType Heuristic;
+	typedef CostType Costs;
+	static constexpr uint8 linkKinds = LinkKinds;
+
+	// the chunk hierarchy and bidirectional search only know the graph as built
+	static constexpr bool bWholeGraph = CostType::bGraphCosts && LinkKinds == NAVLINK_ALL;
+	static constexpr bool bBidirectional = bWholeGraph && HeuristicType::bBidirectional;
+};
+
+typedef TNavSearchPolicy<NavEuclideanHeuristic> NavDefaultPolicy;
+typedef TNavSearchPolicy<NavManhattanHeuristic> NavManhattanPolicy;
+typedef TNavSearchPolicy<NavZeroHeuristic> NavDijkstraPolicy;
+
+// Build and query instrumentation. Off unless the project defines NAV_INSTRUMENTATION 1, in which case
+// BuildNavigation records a timed event per stage and FindPath one per query into NavTrace.
+// Switched off, the macros below compile away and nothing is counted.
+#ifndef NAV_INSTRUMENTATION
+#define NAV_INSTRUMENTATION 0
+#endif
+
+#if NAV_INSTRUMENTATION
+
+#define NAVTRACE_CAPACITY 8192 // events kept, the oldest are overwritten first. Must be a power of two.
+#define NAVTRACE_MAX_ARGS 8
+
+struct NavTraceEvent
+{
+	const TCHAR* name; // must outlive the trace, a string literal
+	double start; // FPlatformTime::Seconds
+	double duration; // seconds
+	uint32 threadId;
+	int numArgs = 0;
+	const TCHAR* argNames[NAVTRACE_MAX_ARGS];
+	double argValues[NAVTRACE_MAX_ARGS];
+
+	void AddArg(const TCHAR* argName, double value)
+	{
+		if (numArgs < NAVTRACE_MAX_ARGS)
+		{
+			argNames[numArgs] = argName;
+			argValues[numArgs++] = value;
+		}
+	}
+};
+
+// Process-wide ring of recent events from every pawn and thread. Recording claims a slot with one
+// atomic increment and never takes a lock, so it's safe from ParallelFor workers too.
+class NavTrace
+{
+public:
+	static void Record(const NavTraceEvent& event);
+	static bool DumpChromeTrace(const FString& filename); // trace-event JSON for chrome://tracing or Perfetto
+	static void Reset();
+
+private:
+	static NavTraceEvent events[NAVTRACE_CAPACITY];
+	static volatile int64 sequences[NAVTRACE_CAPACITY]; // index of the event each slot holds, -1 while it's written
+	static volatile int64 head; // events ever recorded
+};
+
+// Records the enclosing scope as one event when it ends
+struct NavTraceScope
+{
+	NavTraceEvent event;
+
+	NavTraceScope(const TCHAR* name)
+	{
+		event.name = name;
+		event.start = FPlatformTime::Seconds();
+	}
+
+	~NavTraceScope()
+	{
+		event.duration = FPlatformTime::Seconds() - event.start;
+		NavTrace::Record(event);
+	}
+};
+
+// What the current FindPath query has done so far, recorded when it finishes
+struct NavQueryStats
+{
+	double start = 0.0; // BeginPath
+	double searchTime = 0.0; // seconds spent in StepPath, less than the wall time for a sliced query
+	int expanded = 0;
+	int openPeak = 0;
+	int decreaseKeys = 0;
+	int allocations = 0; // times a search array had to grow
+};
+
+#define NAV_TRACE_SCOPE(Name) NavTraceScope navTraceScope(TEXT(Name))
+#define NAV_STAT(Expr) Expr
+
+#else
+
+#define NAV_TRACE_SCOPE(Name)
+#define NAV_STAT(Expr)
+
+#endif
+
+// How FindPath searches, shared by the batch workers so they answer the way the caller would
+struct NavQuerySettings
+{
+	bool bContractRuns = false; // run straight between platform cells that matter instead of expanding every cell
+	bool bUsePathCache = true; // look FindPath queries up in NavPathCache first
+	bool bBidirectional = false; // search from the start and back from the goal at once, ignores bContractRuns
+	bool bNearestReachableGoal = false; // when the goal can't be reached, head for the nearest nav point that can instead
+	int nearestGoalRadius = 64; // how far around the goal bNearestReachableGoal looks, in cells
 };
 
 class NavSystem
 {
+	friend struct NavBenchmark; // times the build stages one by one, see Benchmark/
+
 public:
 	NavSystem(void);
 	~NavSystem(void);
 
-	void BuildNavigation(int jump_height, int pawn_height, int world_width, int world_height, std::vector<uint8> collision_map);
+	void BuildNavigation(int jump_height, int pawn_height, int world_width, int world_height, const std::vector<uint8>& collision_map, uint32 map_version = 0); // map_version 0 = use a checksum of collision_map
+	bool SaveNavigation(const FString& filename) const; // the current graph, for LoadNavigation
+	bool LoadNavigation(const FString& filename, int jump_height, int pawn_height, int world_width, int world_height, const std::vector<uint8>& collision_map, uint32 map_version = 0); // false if the file doesn't match, BuildNavigation then
+	void UpdateRegion(int x0, int z0, int x1, int z1, const std::vector<uint8>& newCells, uint32 map_version = 0); // inclusive cell rect, newCells row by row
+	void UpdateLandmarks() const; // after UpdateRegion, queries go without landmarks until this. Fine on a worker thread while no edit is made.
 	FVector FindPath(FVector start, FVector goal);
-	TArray<TSharedPtr<PathNode>> GetPath();
+	template <typename Policy> FVector FindPath(FVector start, FVector goal); // this query only, e.g. FindPath<NavDijkstraPolicy>
+	template <typename Policy> void SetSearchPolicy(); // every query from now on, NavDefaultPolicy until this is called
+	const TArray<const PathNode*>& GetPath() const; // goal first, valid until the next FindPath
+	FVector BeginPath(FVector start, FVector goal); // FindPath spread over several calls to StepPath, returns the same location
+	ENavPathStatus StepPath(int maxExpansions, double maxMicroseconds = 0.0); // 0 microseconds = no time limit
+	void CancelPath();
+	ENavPathStatus GetPathStatus() const { return pathStatus; }
+	void GetJumpPath(const PathNode& node, TArray<unsigned int>& cells) const; // cells a jump step on GetPath passes through, empty for other steps
+	void FindPaths(const TArray<NavPathRequest>& requests, NavPathBatch& out); // many pawns at once, on the same map as this one's graph
+	bool BuildFlowField(FVector goal, NavFlowField& field); // routes to one goal for every pawn on this graph
+	FVector FollowFlowField(const NavFlowField& field, FVector start); // fills GetPath like FindPath, without searching
+
+	// streaming, for worlds that arrive a strip of columns at a time instead of as one map
+	void BeginStreaming(int jump_height, int pawn_height, int strip_width, int world_height, int max_strips); // nothing attached yet
+	bool AttachStrip(int strip, const std::vector<uint8>& collision_strip); // world strip index, strip_width x world_height cells row by row
+	void EvictStrip(int strip);
+	bool IsStripAttached(int strip) const;
+	int GetStreamOrigin() const { return streamOrigin; } // world column of graph column 0, cells on GetPath are relative to it
 
 	void DeleteAll();
 	void DeleteNav();
@@ -85,6 +774,15 @@ public:
 	unsigned int mapWidth = 0;
 	unsigned int mapHeight = 0;
 	unsigned int cellSize = 32;
+	bool bParallelBuild = true; // spread link generation over the task graph, the result is identical either way
+	int chunkSize = 32; // cells per side of a hierarchy chunk, 0 = always search the flat graph
+	bool bParallelBatch = true; // spread FindPaths requests over the task graph
+	bool bValidateNavFiles = true; // LoadNavigation checks every index in the file, off for files the game cooked itself
+	NavQuerySettings query;
+	int numLandmarks = 0; // ALT landmarks placed at build time, each costs 8 bytes per node
+	int maxReachComponents = 4096; // reachability bitmaps take components^2 / 8 bytes, past this only the component order is checked
+	int maxJumpHeight = 0; // either above 0 builds one graph for every profile up to these, not one per profile,
+	int maxPawnHeight = 0; // and each query keeps to the links its pawn can take. It gets no chunk hierarchy.
 
 	// example map for testing
 	std::vector<uint8> map1 = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,0,1,1,1,0,0,0,1,1,1,1,1,0,0,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,0,1,1,1,0,0,0,1,1,0,0,1,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,0,0,0,0,0,1,1,1,0,0,0,1,1,0,1,1,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,0,0,0,0,0,1,1,1,1,1,1,1,1,0,1,1,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,0,0,0,0,0,1,1,1,1,1,1,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,0,1,1,0,0,1,1,1,1,1,1,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,1,1,1,0,0,1,1,1,1,1,1,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,0,0,0,1,1,1,0,0,1,1,1,1,1,1,1,1,1,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,1,1,1,1,1,0,0,1,1,1,1,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,0,0,0,0,1,0,1,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,1,0,1,1,1,1,1,1,1,1,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,0,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
@@ -93,28 +791,329 @@ public:
 
 private:
 	// navmap building
-	void DetectPlatforms(std::vector<uint8>& MapIn);
-	void CreateRunLinks();
-	void CreateFallLinks();
-	void CreateJumpLinks(int jumpHeight);
-	void CalculateJumpAtPoint(int height, int base);
-	void AddJumpLink(int target, int base, int height, int offset, int horizontal, TArray<unsigned int> path);
+	void DetectPlatforms(NavGraph& nav, const std::vector<uint8>& MapIn);
+	uint8 ClassifyCell(const NavGraph& nav, int x, int z) const;
+	int GetBuildBlocks(const NavGraph& nav, int& blockSize) const;
+	void CreateRunLinks(const NavGraph& nav);
+	void CreateRunLinksAt(const NavGraph& nav, int cell, NavPoint& point);
+	void CreateFallLinks(const NavGraph& nav);
+	void CreateFallLinksAt(const NavGraph& nav, int cell, NavPoint& point);
+	void CreateJumpLinks(const NavGraph& nav);
+	void CreateJumpLinksAt(const NavGraph& nav, int cell, NavPoint& point, JumpBuildScratch& scratch) const;
+	void CompileJumpStencils(int jumpHeight);
+	void AddStencilStep(int dx, int dz, int horizontal, int linkHeight, int& topDz, uint8 flags);
+	void TraceJumpArc(const NavGraph& nav, const JumpStencil& arc, int base, bool bInterior, NavPoint& point, JumpBuildScratch& scratch) const;
+	void AddJumpLink(int target, int base, const JumpStencil& arc, const JumpStencilStep& step, int minPawnHeight, int maxPawnHeight, NavPoint& point) const;
+	void FinalizeGraph(NavGraph& nav);
+	void PackLinks(NavGraph& nav, int node, const NavPoint& point);
+	void CompactEdges(NavGraph& nav);
+	void BuildReverseLinks(NavGraph& nav);
+	void PatchReverseLinks(NavGraph& nav);
+
+	// run shortcuts
+	bool IsRunStop(const NavGraph& nav, int node) const;
+	void LinkPlatforms(NavGraph& nav);
+	int LinkPlatform(NavGraph& nav, int cell);
+
+	// landmark heuristic
+	void BuildLandmarks(const NavGraph& nav, int count) const;
+	void SearchLandmark(const NavGraph& nav, int source, bool bReverse, TArray<float>& dist, TArray<NavQueueItem>& queue) const;
+	float GetLandmarkBound(int node, float h) const;
+
+	// reachability
+	void BuildComponents(const NavGraph& nav) const;
+	void UpdateComponents() const;
+	int FindNearestReachable(int startNode, int goalCell) const;
+
+	// chunk hierarchy
+	void BuildHierarchy(NavGraph& nav);
+	void BuildChunk(NavGraph& nav, int chunk, ChunkSearchScratch& scratch) const;
+	void CountCrossLinks(NavGraph& nav, int node, int delta);
+	bool ChunkLinksDiffer(const NavGraph& nav, int node, unsigned int oldStart, unsigned int oldCount) const;
+	void GatherChunk(const NavGraph& nav, int chunk, bool bReverse, ChunkSearchScratch& scratch) const;
+	int SearchChunk(const NavGraph& nav, int source, int numEntrances, ChunkSearchScratch& scratch) const;
+	bool IsLongQuery(int startNode, int goalNode) const;
+	template <bool bLandmarks> ENavPathStatus ExpandCorridor(int maxExpansions, double deadline, int& expanded);
+	template <bool bLandmarks> void AddAbstractNode(int node, float newCost, int parent);
+
+	// streaming
+	void RebaseStream(int firstStrip);
+	void ShiftGraph(NavGraph& nav, int dx);
+
+	// batched queries
+	void AppendPath(FVector goal, NavPathBatch& out) const;
+	void RestorePath(const NavPathBatch& path);
 
 	// pathfinding
+	NavGraphKey SetProfile(int jump_height, int pawn_height, const std::vector<uint8>& collision_map, uint32 map_version);
+	bool SnapStart(FVector start, int& start_x, int& start_z) const;
+	bool SnapGoal(FVector goal, int& goal_x, int& goal_z) const;
+	void GetLinkDirections(int fromCell, const NavEdge& edge, TArray<unsigned int>& path) const;
 	void SetStartAndGoal(int start_x, int start_z, int goal_x, int goal_z);
+	void SetSearchStart();
 	void CheckPath();
-	TSharedPtr<PathNode> GetNextNode();
-	void AddNodeToOpenList(int x, int z, float newCost, TSharedPtr<PathNode> parent, TArray<unsigned int> path, int type, int bez[2]);
+	ENavPathStatus ExpandPath(int maxExpansions, double deadline);
+	int GetNextNode();
+	void SetPathStep(PathNode& node) const;
+	void CollectPath();
+
+	// search policies, defined below the class. The bools are what a query decides once, in SetSearchStart.
+	template <typename Policy, bool bRunShortcuts, bool bInCorridor, bool bLandmarks> ENavPathStatus ExpandPathT(int maxExpansions, double deadline);
+	template <typename Heuristic, bool bLandmarks> float GetHeuristicT(int node) const;
+	template <typename Heuristic, bool bLandmarks> void AddNodeToOpenList(int node, float newCost, int parent, int edge);
+	template <typename Heuristic, bool bLandmarks, bool bInCorridor> void AddRunShortcut(int current, int side, float runCost);
 
-	TArray<NavPoint> navMap;
-	TArray<unsigned int> platformsReached;
+	// what SetSearchPolicy picked, as the instantiations to call
+	struct SearchPolicy
+	{
+		ENavPathStatus (NavSystem::*expand[8])(int maxExpansions, double deadline); // [run shortcuts + 2 * corridor + 4 * landmarks]
+		float (NavSystem::*heuristic[2])(int node) const; // [landmarks]
+		uint32 id; // for NavPathKey
+		bool bWholeGraph;
+		bool bBidirectional;
+	};
+
+	// bidirectional search
+	void SetBidirectionalStart();
+	template <bool bInCorridor> ENavPathStatus ExpandBidirectional(int maxExpansions, double deadline);
+	BidirectionalNode& GetBidirectionalNode(int node);
+	void AddBidirectionalNode(int side, int node, float newCost, int parent, int edge);
+	void BuildBidirectionalPath();
+
+	// search node arena and open list (binary min-heap on F, indexed by graph node id)
+	void ResetSearchState();
+	PathNode& GetSearchNode(int node);
+	void OpenListPush(int node);
+	int OpenListPop();
+	void OpenListSiftUp(int heapPos);
+	void OpenListSiftDown(int heapPos);
+
+#if NAV_INSTRUMENTATION
+	void RecordQuery(bool bCacheHit);
+	static void AddGraphArgs(NavTraceEvent& event, const NavGraph& nav);
+#endif
+
+	TArray<NavPoint> navMap; // per node build data, freed once packed into graph
+	NavGraphPtr graph; // shared with every other pawn on the same jump profile
+	NavPoint updatePoint; // scratch links for one nav point during UpdateRegion
+	TArray<int> updateCells; // cells UpdateRegion regenerates links for
+	TArray<uint8> dirtyChunks; // chunks UpdateRegion has to rebuild
+	TArray<int> crossChanges; // changes UpdateRegion made to NavHierarchy::crossIn, see CountCrossLinks
+	TArray<int> relinkCells; // cells on platforms whose run shortcuts UpdateRegion has to redo
+	TArray<uint8> updateNodes; // per node, 1 if UpdateRegion replaced its links
+	TArray<int> updateTargets; // nodes whose incoming links UpdateRegion changed, with repeats
+	TArray<NavReverseLink> updateLinks; // links UpdateRegion added
+	TArray<NavQueueItem> flowQueue;
+	NavPathBatch cachedPath; // scratch for NavPathCache copies
+	ChunkSearchScratch chunkScratch; // for UpdateRegion, and the start end of a hierarchical query
+	ChunkSearchScratch goalChunkScratch;
+	JumpBuildScratch updateScratch;
+	JumpStencilTable jumpStencils;
+	int minNodesPerBuildBlock = 64;
 	unsigned int maxDropsAfterJump = 10;
-	int verticalSize = 1;
+	int verticalSize = 1; // the pawn's own profile, which queries filter the links on
+	int jumpHeight = 0;
 
-	TSharedPtr<PathNode> startNode;
-	TSharedPtr<PathNode> goalNode;
-	TArray<TSharedPtr<PathNode>> openList;
-	TArray<TSharedPtr<PathNode>> visitedList;
-	TArray<TSharedPtr<PathNode>> pathNodesToGoal;
+	int startIndex = -1;					// node ids
+	int goalIndex = -1;
+	TArray<PathNode> searchNodes;			// arena, one record per graph node, kept between queries
+	unsigned int searchId = 0;				// stamps the records that belong to the current query
+	TArray<int> openList;					// heap of node ids ordered by F, openList[0] is the best node
+	TArray<const PathNode*> pathNodesToGoal;
+	ENavPathStatus pathStatus = ENavPathStatus::Idle;
+	NavPathKey pathKey;						// of the query in progress, for NavPathCache once it's done
+	FVector pathGoal;
+	TArray<BidirectionalNode> bidiNodes;	// arena for bidirectional searches, stamped with searchId too
+	TArray<NavQueueItem> bidiQueue[2];		// lazy-deletion heaps keyed on G +- potential
+	float bidiBest = MAX_flt;				// cheapest start to goal route seen where the two sides touch
+	int bidiMeet = -1;						// node that route passes through
+	TArray<int> bidiRoute;					// edge ids from start to goal, while the path is built
+	bool bBidirectionalSearch = false;
+	bool bLandmarkSearch = false;			// the graph's landmarks were fresh when the query started
+	SearchPolicy searchPolicy;
+	uint8 searchLoop = 0;					// index into searchPolicy.expand for the query in progress
+	TArray<TSharedPtr<NavSystem>> batchWorkers;	// search state for each FindPaths block, kept between batches
+	TArray<NavPathBatch> batchBlocks;		// each block's share of the output before it's joined up
+	TArray<NavGraphPtr> batchGraphs;		// per request
+	TArray<unsigned int> corridorStamp;		// per chunk, set to corridorId for the chunks the search may enter
+	unsigned int corridorId = 0;
+	bool bCorridorSearch = false;
+	uint8 corridorState = 0;				// 0 = no corridor left to find, 1 = hook the start onto its chunk, 2 = the goal, 3 = search the entrances
+	int streamStripWidth = 0;				// columns per strip, 0 when not streaming
+	int streamMaxStrips = 0;				// attached at once, the graph has room for twice as many
+	int streamFirstStrip = 0;				// world strip in graph columns [0, streamStripWidth)
+	int streamOrigin = 0;					// streamFirstStrip * streamStripWidth
+	TArray<uint8> streamAttached;			// per strip slot in the graph, 1 if a strip is attached there
+	std::vector<uint8> streamCells;			// scratch collision for evicting and rebasing
+#if NAV_INSTRUMENTATION
+	NavQueryStats queryStats;
+#endif
 
-};
\ No newline at end of file
+};
+template <typename Policy>
+FVector NavSystem::FindPath(FVector start, FVector goal)
+{
+	SearchPolicy ownPolicy = searchPolicy;
+	SetSearchPolicy<Policy>();
+	FVector goalLocation = FindPath(start, goal);
+	searchPolicy = ownPolicy;
+	return goalLocation;
+}
+
+template <typename Policy>
+void NavSystem::SetSearchPolicy()
+{
+	static const uint32 policyId = NavPathCache::NewPolicyId();
+
+	// a time sliced query can't change search loops halfway
+	if (pathStatus == ENavPathStatus::InProgress)
+	{
+		CancelPath();
+	}
+
+	// variants the policy can't tell apart share one instantiation
+	typedef typename Policy::Heuristic Heuristic;
+	constexpr bool bCorridor = Policy::bWholeGraph;
+	constexpr bool bLandmarks = Heuristic::bUseLandmarks;
+	searchPolicy.expand[0] = &NavSystem::ExpandPathT<Policy, false, false, false>;
+	searchPolicy.expand[1] = &NavSystem::ExpandPathT<Policy, true, false, false>;
+	searchPolicy.expand[2] = &NavSystem::ExpandPathT<Policy, false, bCorridor, false>;
+	searchPolicy.expand[3] = &NavSystem::ExpandPathT<Policy, true, bCorridor, false>;
+	searchPolicy.expand[4] = &NavSystem::ExpandPathT<Policy, false, false, bLandmarks>;
+	searchPolicy.expand[5] = &NavSystem::ExpandPathT<Policy, true, false, bLandmarks>;
+	searchPolicy.expand[6] = &NavSystem::ExpandPathT<Policy, false, bCorridor, bLandmarks>;
+	searchPolicy.expand[7] = &NavSystem::ExpandPathT<Policy, true, bCorridor, bLandmarks>;
+	searchPolicy.heuristic[0] = &NavSystem::GetHeuristicT<Heuristic, false>;
+	searchPolicy.heuristic[1] = &NavSystem::GetHeuristicT<Heuristic, bLandmarks>;
+	searchPolicy.id = policyId;
+	searchPolicy.bWholeGraph = Policy::bWholeGraph;
+	searchPolicy.bBidirectional = Policy::bBidirectional;
+}
+
+// CheckPath that gives up after maxExpansions nodes, or once FPlatformTime::Seconds passes deadline (0 = never),
+// leaving the open list as it is so the next call carries on. The clock is only read every 16 nodes.
+// bRunShortcuts is query.bContractRuns, bInCorridor bCorridorSearch, and bLandmarks whether the graph has any.
+template <typename Policy, bool bRunShortcuts, bool bInCorridor, bool bLandmarks>
+ENavPathStatus NavSystem::ExpandPathT(int maxExpansions, double deadline)
+{
+	typedef typename Policy::Heuristic Heuristic;
+
+	for (int expanded = 0; openList.Num() > 0; expanded++)
+	{
+		if (expanded >= maxExpansions || (deadline > 0.0 && expanded > 0 && (expanded & 15) == 0 && FPlatformTime::Seconds() >= deadline))
+		{
+			return ENavPathStatus::InProgress;
+		}
+
+		int current = GetNextNode();
+		const PathNode& currentNode = searchNodes[current];
+		int currentCell = currentNode.index;
+
+		if (current == goalIndex) // if goal reached
+		{
+			CollectPath();
+			return ENavPathStatus::Found;
+		}
+
+		unsigned int edgeEnd = graph->edgeStart[current] + graph->edgeCount[current];
+		for (unsigned int e = graph->edgeStart[current]; e < edgeEnd; e++)
+		{
+			const NavEdge& edge = graph->edges[e];
+			if (!(Policy::linkKinds & (1 << edge.kind)) || !edge.Fits(jumpHeight, verticalSize))
+			{
+				continue;
+			}
+
+			int targetCell = graph->nodeCell[edge.target];
+			float cost = Policy::Costs::Cost(edge);
+
+			if (bRunShortcuts && edge.kind == 1)
+			{
+				AddRunShortcut<Heuristic, bLandmarks, bInCorridor>(current, targetCell > currentCell ? 1 : 0, cost);
+				continue;
+			}
+
+			if (bInCorridor && corridorStamp[graph->GetChunk(edge.target)] != corridorId)
+			{
+				continue;
+			}
+
+			AddNodeToOpenList<Heuristic, bLandmarks>(edge.target, currentNode.G + cost, current, e);
+		}
+	}
+
+	// if nothing is left in openList a path cannot be found
+	UE_LOG(LogTemp, Error, TEXT("No path to goal found."));
+	return ENavPathStatus::Failed;
+}
+
+// Estimated cost from a node to the goal, bLandmarks only if the graph has some
+template <typename Heuristic, bool bLandmarks>
+float NavSystem::GetHeuristicT(int index) const
+{
+	const PathNode& node = searchNodes[index];
+	const PathNode& goal = searchNodes[goalIndex];
+	float h = Heuristic::Estimate(node.x_coord - goal.x_coord, node.z_coord - goal.z_coord);
+
+	return Heuristic::bUseLandmarks && bLandmarks ? GetLandmarkBound(index, h) : h;
+}
+
+// Reached a node by graph edge edgeIndex, or by a run shortcut along the platform if it's -1. Only the edge is
+// recorded, the directions are worked out for the nodes on the final path (SetPathStep).
+template <typename Heuristic, bool bLandmarks>
+void NavSystem::AddNodeToOpenList(int index, float newCost, int parent, int edgeIndex)
+{
+	PathNode& node = GetSearchNode(index);
+
+	// already expanded, so it can't be improved
+	if (node.state == 2)
+	{
+		return;
+	}
+
+	// already in openList, so only take this route if it's cheaper
+	// (H is the same for both, so smaller G means smaller F)
+	if (node.state == 1 && newCost >= node.G)
+	{
+		return;
+	}
+
+	node.G = newCost;
+	node.parent = parent;
+	node.edge = edgeIndex;
+
+	if (node.state == 1)
+	{
+		OpenListSiftUp(node.heapIndex); // F only got smaller, so it can only move up
+		NAV_STAT(queryStats.decreaseKeys++);
+	}
+	else
+	{
+		node.H = GetHeuristicT<Heuristic, bLandmarks>(index);
+		OpenListPush(index);
+	}
+}
+
+// Run along the platform from current to the next stop in that direction (0 = left, 1 = right),
+// or to the goal if it's on the way. runCost is what one cell of running costs.
+template <typename Heuristic, bool bLandmarks, bool bInCorridor>
+void NavSystem::AddRunShortcut(int current, int side, float runCost)
+{
+	const PathNode& currentNode = searchNodes[current];
+	const PathNode& goalNode = searchNodes[goalIndex];
+	int stop = graph->runSkip[current * 2 + side];
+	int stopX = stop >= 0 ? graph->nodeCell[stop] % mapWidth : currentNode.x_coord;
+
+	if (goalNode.z_coord == currentNode.z_coord
+		&& (side ? goalNode.x_coord > currentNode.x_coord && goalNode.x_coord < stopX
+			: goalNode.x_coord < currentNode.x_coord && goalNode.x_coord > stopX))
+	{
+		AddNodeToOpenList<Heuristic, bLandmarks>(goalIndex, currentNode.G + runCost * FPlatformMath::Abs(goalNode.x_coord - currentNode.x_coord), current, -1);
+		return;
+	}
+
+	if (stop >= 0 && !(bInCorridor && corridorStamp[graph->GetChunk(stop)] != corridorId))
+	{
+		AddNodeToOpenList<Heuristic, bLandmarks>(stop, currentNode.G + runCost * FPlatformMath::Abs(stopX - currentNode.x_coord), current, -1);
+	}
+}